@@ -0,0 +1,162 @@
+﻿#pragma once
+
+//
+// 文字列を番号に置き換える(インターン)
+//   同じ文字列からは同じ番号が得られるので、比較は整数の比較で済む
+//   TIPS:一度登録した文字列は消さない
+//
+
+#include <string>
+#include <cstring>
+#include <ostream>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+
+
+namespace ngs {
+
+class Atom
+{
+  u_int id_ = 0;
+
+
+  // 表のキー
+  //   TIPS:namesの文字列を指すだけなので、探す時に文字列を作らなくて済む
+  struct Key
+  {
+    const char* data;
+    size_t size;
+  };
+
+  // FNV-1a
+  struct KeyHash
+  {
+    size_t operator()(const Key& key) const noexcept
+    {
+      size_t hash = 2166136261u;
+      for (size_t i = 0; i < key.size; ++i)
+      {
+        hash = (hash ^ static_cast<unsigned char>(key.data[i])) * 16777619u;
+      }
+      return hash;
+    }
+  };
+
+  struct KeyEqual
+  {
+    bool operator()(const Key& a, const Key& b) const noexcept
+    {
+      return (a.size == b.size) && !std::memcmp(a.data, b.data, a.size);
+    }
+  };
+
+  struct Table
+  {
+    std::mutex mutex;
+    std::unordered_map<Key, u_int, KeyHash, KeyEqual> ids;
+    // TIPS:参照を返し、キーからも指すので要素の移動しないコンテナ
+    std::deque<std::string> names;
+
+    Table()
+    {
+      // 0番は空文字列
+      names.push_back(std::string());
+      ids.insert({ { names.back().data(), 0 }, 0 });
+    }
+  };
+
+  static Table& table() noexcept
+  {
+    static Table table;
+    return table;
+  }
+
+  static u_int intern(const std::string& name) noexcept
+  {
+    auto& t = table();
+    std::lock_guard<std::mutex> lock(t.mutex);
+
+    auto it = t.ids.find({ name.data(), name.size() });
+    if (it != std::end(t.ids)) return it->second;
+
+    u_int id = u_int(t.names.size());
+    t.names.push_back(name);
+    t.ids.insert({ { t.names.back().data(), name.size() }, id });
+    return id;
+  }
+
+
+public:
+  Atom() = default;
+
+  Atom(const std::string& name) noexcept
+    : id_(intern(name))
+  {}
+
+  Atom(const char* name) noexcept
+    : id_(intern(name))
+  {}
+
+
+  // 登録済みの文字列だけ探す
+  //   登録されていなければfalse(新しく登録しない)
+  //   TIPS:文字列の一部を渡せるので、切り出して文字列を作らなくて済む
+  static bool find(const char* name, const size_t length, Atom& atom) noexcept
+  {
+    auto& t = table();
+    std::lock_guard<std::mutex> lock(t.mutex);
+
+    auto it = t.ids.find({ name, length });
+    if (it == std::end(t.ids)) return false;
+
+    atom.id_ = it->second;
+    return true;
+  }
+
+
+  u_int id() const noexcept
+  {
+    return id_;
+  }
+
+  const std::string& str() const noexcept
+  {
+    auto& t = table();
+    std::lock_guard<std::mutex> lock(t.mutex);
+    return t.names[id_];
+  }
+
+  bool empty() const noexcept
+  {
+    return id_ == 0;
+  }
+
+
+  bool operator==(const Atom& rhs) const noexcept { return id_ == rhs.id_; }
+  bool operator!=(const Atom& rhs) const noexcept { return id_ != rhs.id_; }
+  bool operator<(const Atom& rhs) const noexcept  { return id_ < rhs.id_; }
+
+};
+
+
+std::ostream& operator<<(std::ostream& os, const Atom& atom) noexcept
+{
+  return os << atom.str();
+}
+
+}
+
+
+namespace std {
+
+template<>
+struct hash<ngs::Atom>
+{
+  size_t operator()(const ngs::Atom& atom) const noexcept
+  {
+    return std::hash<ngs::u_int>()(atom.id());
+  }
+};
+
+}
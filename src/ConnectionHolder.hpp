@@ -7,6 +7,7 @@
 #include <vector>
 #include <boost/noncopyable.hpp>
 #include "Event.hpp"
+#include "Delegate.hpp"
 
 
 namespace ngs {
@@ -15,6 +16,7 @@ class ConnectionHolder
   : private boost::noncopyable
 {
   std::vector<Connection> connections_;
+  std::vector<DelegateConnection> delegates_;
 
 
 public:
@@ -26,10 +28,7 @@ public:
 
   ~ConnectionHolder() noexcept
   {
-    for (auto& connection : connections_)
-    {
-      connection.disconnect();
-    }
+    clear();
   }
 
 
@@ -39,8 +38,13 @@ public:
     {
       connection.disconnect();
     }
+    for (auto& connection : delegates_)
+    {
+      connection.disconnect();
+    }
 
     connections_.clear();
+    delegates_.clear();
   }
 
 
@@ -54,6 +58,11 @@ public:
     connections_.push_back(connection);
   }
 
+  void operator += (const DelegateConnection& connection) noexcept
+  {
+    delegates_.push_back(connection);
+  }
+
 };
 
 }
@@ -15,10 +15,17 @@
 #endif
 
 // TIPS:console() をReleaseビルドで排除する
+//      ヘッドレス版はアプリが無いので標準エラー出力
+#if defined (NGS_HEADLESS)
+#define NGS_CONSOLE std::cerr
+#else
+#define NGS_CONSOLE ci::app::console()
+#endif
+
 #ifdef DEBUG
-#define DOUT ci::app::console()
+#define DOUT NGS_CONSOLE
 #else
-#define DOUT 0 && ci::app::console()
+#define DOUT 0 && NGS_CONSOLE
 #endif
 
 // TIPS:プリプロセッサを文字列として定義する
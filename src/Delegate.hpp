@@ -0,0 +1,360 @@
+﻿#pragma once
+
+//
+// 軽量なイベント通知
+//   boost::signals2の代わりに、関数を配列に並べて順に呼ぶだけ
+//   呼び出し時にメモリ確保もロックもしない
+//   TIPS:呼び出し中の登録・切断もできる
+//        呼び出し中に登録された関数は次の呼び出しから
+//        接続の状態はまとめて確保したものを使い回すので、登録時も確保しない
+//        ただしstd::functionに収まらない大きな関数オブジェクトは、登録時にstd::functionが確保する
+//
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <boost/noncopyable.hpp>
+
+
+namespace ngs {
+
+// 接続
+//   切断はDelegateが破棄された後でも安全
+class DelegateConnection
+{
+  // 接続の状態
+  //   TIPS:参照数が0になったらPoolに戻す
+  struct State
+  {
+    std::atomic<u_int> refs;
+    std::atomic<bool> connected;
+    State* next;
+  };
+
+  // Stateの置き場
+  //   TIPS:別スレッドで切断・破棄されることもあるのでロックする
+  //        登録・最後の破棄の時だけで、呼び出し時は使わない
+  class Pool
+    : private boost::noncopyable
+  {
+    static constexpr u_int block_size = 64;
+
+    std::mutex mutex_;
+    State* free_ = nullptr;
+    std::vector<std::unique_ptr<State[]>> blocks_;
+
+
+  public:
+    State* acquire() noexcept
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!free_)
+      {
+        blocks_.emplace_back(new State[block_size]);
+        auto* block = blocks_.back().get();
+        for (u_int i = 0; i < block_size; ++i)
+        {
+          block[i].next = free_;
+          free_ = &block[i];
+        }
+      }
+
+      auto* state = free_;
+      free_ = state->next;
+      state->refs      = 1;
+      state->connected = true;
+      return state;
+    }
+
+    void release(State* state) noexcept
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      state->next = free_;
+      free_ = state;
+    }
+  };
+
+  // TIPS:静的変数の破棄順に関係なく使えるよう、破棄しない
+  static Pool& pool() noexcept
+  {
+    static Pool* pool = new Pool;
+    return *pool;
+  }
+
+  State* state_ = nullptr;
+
+
+  void release() noexcept
+  {
+    if (state_ && (--state_->refs == 0)) pool().release(state_);
+    state_ = nullptr;
+  }
+
+
+public:
+  DelegateConnection() = default;
+
+  ~DelegateConnection()
+  {
+    release();
+  }
+
+  DelegateConnection(const DelegateConnection& rhs) noexcept
+    : state_(rhs.state_)
+  {
+    if (state_) state_->refs += 1;
+  }
+
+  DelegateConnection(DelegateConnection&& rhs) noexcept
+    : state_(rhs.state_)
+  {
+    rhs.state_ = nullptr;
+  }
+
+  DelegateConnection& operator=(const DelegateConnection& rhs) noexcept
+  {
+    if (rhs.state_) rhs.state_->refs += 1;
+    release();
+    state_ = rhs.state_;
+    return *this;
+  }
+
+  DelegateConnection& operator=(DelegateConnection&& rhs) noexcept
+  {
+    if (this != &rhs)
+    {
+      release();
+      state_ = rhs.state_;
+      rhs.state_ = nullptr;
+    }
+    return *this;
+  }
+
+
+  // 新しく接続する
+  static DelegateConnection create() noexcept
+  {
+    DelegateConnection connection;
+    connection.state_ = pool().acquire();
+    return connection;
+  }
+
+
+  void disconnect() const noexcept
+  {
+    if (state_) state_->connected = false;
+  }
+
+  bool connected() const noexcept
+  {
+    return state_ && state_->connected;
+  }
+
+};
+
+
+template<typename Signature>
+class Delegate;
+
+template<typename... Args>
+class Delegate<void (Args...)>
+  : private boost::noncopyable
+{
+  using Func = std::function<void (const DelegateConnection&, Args...)>;
+
+  struct Slot
+  {
+    DelegateConnection connection;
+    Func func;
+  };
+
+  std::vector<Slot> slots_;
+  // 呼び出し中に登録された関数
+  std::vector<Slot> pending_;
+
+  u_int emitting_ = 0;
+
+
+  // 切断されたものを取り除く
+  void compact() noexcept
+  {
+    slots_.erase(std::remove_if(std::begin(slots_), std::end(slots_),
+                                [](const Slot& slot) { return !slot.connection.connected(); }),
+                 std::end(slots_));
+  }
+
+
+public:
+  Delegate() = default;
+
+  ~Delegate()
+  {
+    disconnectAll();
+  }
+
+
+  // 登録
+  //   callback: void (const DelegateConnection&, Args...)
+  template<typename F>
+  DelegateConnection connect(F callback) noexcept
+  {
+    auto connection = DelegateConnection::create();
+    if (emitting_)
+    {
+      pending_.push_back({ connection, Func(std::move(callback)) });
+    }
+    else
+    {
+      compact();
+      slots_.push_back({ connection, Func(std::move(callback)) });
+    }
+    return connection;
+  }
+
+  void disconnectAll() noexcept
+  {
+    for (auto& slot : slots_)   slot.connection.disconnect();
+    for (auto& slot : pending_) slot.connection.disconnect();
+  }
+
+
+  // 呼び出し
+  void operator()(Args... args) noexcept
+  {
+    emitting_ += 1;
+    bool disconnected = false;
+    // TIPS:呼び出し中はslots_の要素数が変わらない
+    for (auto& slot : slots_)
+    {
+      if (!slot.connection.connected())
+      {
+        disconnected = true;
+        continue;
+      }
+      slot.func(slot.connection, args...);
+    }
+    emitting_ -= 1;
+
+    if (emitting_) return;
+
+    if (disconnected) compact();
+    if (!pending_.empty())
+    {
+      std::move(std::begin(pending_), std::end(pending_), std::back_inserter(slots_));
+      pending_.clear();
+    }
+  }
+
+
+  bool empty() const noexcept
+  {
+    return slots_.empty() && pending_.empty();
+  }
+
+};
+
+
+// 別スレッドから登録・呼び出しをする場合
+//   登録時に一覧を複製して差し替え(コピーオンライト)、呼び出し時はロックして一覧を受け取るだけ
+//   TIPS:関数はロックの外で呼ぶので、関数の中で別のロックを取ったり
+//        別スレッドのDelegateを呼んだりしても行き詰まらない
+//        呼び出し中に別スレッドで切断された関数が、その回だけ呼ばれることはある
+//        登録時は一覧の複製でメモリ確保する
+template<typename Signature>
+class ThreadSafeDelegate;
+
+template<typename... Args>
+class ThreadSafeDelegate<void (Args...)>
+  : private boost::noncopyable
+{
+  using Func = std::function<void (const DelegateConnection&, Args...)>;
+
+  struct Slot
+  {
+    DelegateConnection connection;
+    Func func;
+  };
+
+  using Slots = std::vector<Slot>;
+
+  // TIPS:一度公開した一覧は書き換えない
+  std::shared_ptr<const Slots> slots_;
+  mutable std::mutex mutex_;
+
+
+public:
+  ThreadSafeDelegate() = default;
+
+  ~ThreadSafeDelegate()
+  {
+    disconnectAll();
+  }
+
+
+  // 登録
+  //   callback: void (const DelegateConnection&, Args...)
+  template<typename F>
+  DelegateConnection connect(F callback) noexcept
+  {
+    auto connection = DelegateConnection::create();
+    Slot slot { connection, Func(std::move(callback)) };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto slots = std::make_shared<Slots>();
+    if (slots_)
+    {
+      slots->reserve(slots_->size() + 1);
+      // 切断されたものはここで取り除く
+      std::copy_if(std::begin(*slots_), std::end(*slots_), std::back_inserter(*slots),
+                   [](const Slot& s) { return s.connection.connected(); });
+    }
+    slots->push_back(std::move(slot));
+    slots_ = std::move(slots);
+    return connection;
+  }
+
+  void disconnectAll() noexcept
+  {
+    std::shared_ptr<const Slots> slots;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::swap(slots, slots_);
+    }
+    if (!slots) return;
+
+    for (const auto& slot : *slots) slot.connection.disconnect();
+  }
+
+
+  // 呼び出し
+  void operator()(Args... args) noexcept
+  {
+    std::shared_ptr<const Slots> slots;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slots = slots_;
+    }
+    if (!slots) return;
+
+    for (const auto& slot : *slots)
+    {
+      if (!slot.connection.connected()) continue;
+      slot.func(slot.connection, args...);
+    }
+  }
+
+
+  bool empty() const noexcept
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !slots_ || std::none_of(std::begin(*slots_), std::end(*slots_),
+                                   [](const Slot& s) { return s.connection.connected(); });
+  }
+
+};
+
+}
@@ -4,9 +4,10 @@
 // Ease関連
 //
 
-#include <map>
+#include <unordered_map>
 #include <string>
 #include <cinder/Easing.h>
+#include "Atom.hpp"
 
 
 namespace ngs {
@@ -26,9 +27,9 @@ float elastic_outin_b = 1;
 }
 
 
-ci::EaseFn getEaseFunc(const std::string& name) noexcept
+ci::EaseFn getEaseFunc(const Atom& name) noexcept
 {
-  static const std::map<std::string, ci::EaseFn> tbl = {
+  static const std::unordered_map<Atom, ci::EaseFn> tbl = {
     { "EaseInQuad",    ci::EaseInQuad() },
     { "EaseOutQuad",   ci::EaseOutQuad() },
     { "EaseInOutQuad", ci::EaseInOutQuad() },
@@ -5,8 +5,13 @@
 // SOURCE: fontstash
 //
 
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
 #include <boost/noncopyable.hpp>
 #include <cinder/gl/Texture.h>
+#include <cinder/gl/Pbo.h>
 #include <cinder/TriMesh.h>
 #include "fontstash.h"
 
@@ -16,10 +21,32 @@ namespace ngs {
 class Font
   : private boost::noncopyable
 {
+  // 文字をテクスチャへ転送する範囲 [x1, y1, x2, y2)
+  //   fontstashから渡された範囲を溜めておき、描画の前にまとめて転送する
+  //   TIPS:重なったり隣り合ったりしていて、まとめても転送量が増えないものは一つにする
+  struct Dirty
+  {
+    std::vector<ci::Area> rects;
+    const unsigned char* data = nullptr;
+
+    // TIPS:使う時だけ確保
+    bool use_pbo = false;
+    ci::gl::PboRef pbo;
+
+    // このフレームで転送した量と回数
+    size_t upload_bytes = 0;
+    u_int upload_num = 0;
+  };
+
   struct Context
   {
     ci::gl::Texture2dRef tex;
     int width, height;
+
+    // テクスチャを作り直した回数
+    u_int generation = 0;
+
+    Dirty dirty;
   };
 
   Context gl_;
@@ -31,6 +58,9 @@ class Font
   {
     Context* gl = (Context*)userPtr;
 
+    // TIPS:溜めておいた範囲は古いテクスチャのもの
+    gl->dirty.rects.clear();
+
     // TIPS:テクスチャ内部形式をGL_R8にしといて
     //      シェーダーでなんとかする方式(from nanoVG)
     gl->tex = ci::gl::Texture2d::create(width, height,
@@ -38,6 +68,7 @@ class Font
 
     gl->width  = width;
     gl->height = height;
+    gl->generation += 1;
 
     return 1;
   }
@@ -48,78 +79,129 @@ class Font
     return create(userPtr, width, height);
   }
 
+  // 転送する範囲を覚えておく
+  //   TIPS:転送はupload
   static void update(void* userPtr, int* rect, const unsigned char* data) noexcept
   {
     Context* gl = (Context*)userPtr;
     if (!gl->tex.get()) return;
 
-    int w = rect[2] - rect[0];
-    int h = rect[3] - rect[1];
-
-    // TIPS:data側も切り抜いて転送するので
-    //      その指定も忘れない
-    // glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, gl->width);
-    glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect[0]);
-    glPixelStorei(GL_UNPACK_SKIP_ROWS, rect[1]);
-
-    gl->tex->update(data, GL_RED, GL_UNSIGNED_BYTE, 0, w, h, ci::ivec2(rect[0], rect[1]));
+    gl->dirty.data = data;
+    addDirty(gl->dirty.rects, ci::Area(rect[0], rect[1], rect[2], rect[3]));
   }
 
-  // FIXME: ci::glのコードを参考にした
-  //        ちょいと重い
-  static void draw(void* userPtr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts) noexcept
+  static int64_t areaSize(const ci::Area& area) noexcept
   {
-    using namespace ci;
+    return int64_t(area.getWidth()) * int64_t(area.getHeight());
+  }
 
-    Context* gl = (Context*)userPtr;
-    if (!gl->tex.get()) return;
+  // 範囲を追加
+  //   まとめた方が転送量が増えない範囲と一つにする
+  static void addDirty(std::vector<ci::Area>& rects, ci::Area area) noexcept
+  {
+    if ((area.x1 >= area.x2) || (area.y1 >= area.y2)) return;
 
-    auto* ctx = gl::context();
-    const gl::GlslProg* curGlslProg = ctx->getGlslProg();
+    bool merged = true;
+    while (merged)
+    {
+      merged = false;
+      for (auto it = std::begin(rects); it != std::end(rects); ++it)
+      {
+        ci::Area u(std::min(area.x1, it->x1), std::min(area.y1, it->y1),
+                   std::max(area.x2, it->x2), std::max(area.y2, it->y2));
+        if (areaSize(u) > (areaSize(area) + areaSize(*it))) continue;
+
+        // TIPS:大きくなったので、他の範囲ともまとめられるかもう一度調べる
+        area = u;
+        rects.erase(it);
+        merged = true;
+        break;
+      }
+    }
+    rects.push_back(area);
+  }
 
-    size_t totalArrayBufferSize = sizeof(float) * nverts * 2
-      + sizeof(float) * nverts * 2
-      + nverts * 4;
+  // 溜めておいた範囲をテクスチャへ転送
+  static void upload(Context* gl) noexcept
+  {
+    auto& dirty = gl->dirty;
+    if (dirty.rects.empty()) return;
+    if (!gl->tex.get() || !dirty.data)
+    {
+      dirty.rects.clear();
+      return;
+    }
 
-    ctx->pushVao();
-    ctx->getDefaultVao()->replacementBindBegin();
+    size_t bytes = 0;
+    for (const auto& r : dirty.rects)
+    {
+      bytes += size_t(areaSize(r));
+    }
 
-    gl::VboRef defaultArrayVbo = ctx->getDefaultArrayVbo( totalArrayBufferSize );
+    // TIPS:PBOに書き込めなかったら直接転送する
+    if (!dirty.use_pbo || !uploadPbo(gl, bytes))
+    {
+      // TIPS:data側も切り抜いて転送するので
+      //      その指定も忘れない
+      glPixelStorei(GL_UNPACK_ALIGNMENT,   1);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH,  gl->width);
+      for (const auto& r : dirty.rects)
+      {
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, r.x1);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS,   r.y1);
+        gl->tex->update(dirty.data, GL_RED, GL_UNSIGNED_BYTE, 0, r.getWidth(), r.getHeight(), ci::ivec2(r.x1, r.y1));
+      }
+      glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+      glPixelStorei(GL_UNPACK_SKIP_ROWS,   0);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH,  0);
+      glPixelStorei(GL_UNPACK_ALIGNMENT,   4);
+    }
 
-    gl::ScopedBuffer vboScp( defaultArrayVbo );
-    gl::ScopedTextureBind texScp( gl->tex );
+    dirty.upload_bytes += bytes;
+    dirty.upload_num   += u_int(dirty.rects.size());
+    dirty.rects.clear();
+  }
 
-    size_t curBufferOffset = 0;
+  // PBO経由で転送
+  //   範囲ごとに行を詰めて書き込んでから転送する(CPUは転送の完了を待たない)
+  //   TIPS:書き込めなかったらfalse
+  static bool uploadPbo(Context* gl, const size_t bytes) noexcept
+  {
+    auto& dirty = gl->dirty;
+    if (!dirty.pbo || (size_t(dirty.pbo->getSize()) < bytes))
     {
-      int loc = curGlslProg->getAttribSemanticLocation( geom::Attrib::POSITION );
-      gl::enableVertexAttribArray( loc );
-      gl::vertexAttribPointer( loc, 2, GL_FLOAT, GL_FALSE, 0, (void*)curBufferOffset );
-      defaultArrayVbo->bufferSubData( curBufferOffset, sizeof(float) * nverts * 2, verts );
-      curBufferOffset += sizeof(float) * nverts * 2;
+      dirty.pbo = ci::gl::Pbo::create(GL_PIXEL_UNPACK_BUFFER, std::max(bytes, size_t(64 * 1024)), nullptr, GL_STREAM_DRAW);
     }
 
+    ci::gl::ScopedBuffer pbo(dirty.pbo);
+    // TIPS:前回の転送が終わっていなくても書き込めるように捨ててから使う
+    dirty.pbo->bufferData(dirty.pbo->getSize(), nullptr, GL_STREAM_DRAW);
+    auto* dst = static_cast<unsigned char*>(dirty.pbo->mapBufferRange(0, bytes,
+                                                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (!dst) return false;
+
+    size_t offset = 0;
+    for (const auto& r : dirty.rects)
     {
-      int loc = curGlslProg->getAttribSemanticLocation( geom::Attrib::TEX_COORD_0 );
-      gl::enableVertexAttribArray( loc );
-      gl::vertexAttribPointer( loc, 2, GL_FLOAT, GL_FALSE, 0, (void*)curBufferOffset );
-      defaultArrayVbo->bufferSubData( curBufferOffset, sizeof(float) * nverts * 2, tcoords );
-      curBufferOffset += sizeof(float)* nverts * 2;
+      int w = r.getWidth();
+      for (int y = r.y1; y < r.y2; ++y)
+      {
+        std::memcpy(dst + offset, dirty.data + y * gl->width + r.x1, w);
+        offset += w;
+      }
     }
+    dirty.pbo->unmap();
 
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    offset = 0;
+    for (const auto& r : dirty.rects)
     {
-      int loc = curGlslProg->getAttribSemanticLocation( geom::Attrib::COLOR );
-      gl::enableVertexAttribArray( loc );
-      gl::vertexAttribPointer( loc, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (void*)curBufferOffset );
-      defaultArrayVbo->bufferSubData( curBufferOffset, nverts * 4, colors );
-      // curBufferOffset += nverts * 4;
+      // TIPS:PBOが設定されている時はポインタの代わりにPBO内の位置を渡す
+      gl->tex->update((const void*)offset, GL_RED, GL_UNSIGNED_BYTE, 0, r.getWidth(), r.getHeight(), ci::ivec2(r.x1, r.y1));
+      offset += size_t(areaSize(r));
     }
-
-    ctx->getDefaultVao()->replacementBindEnd();
-
-    ctx->setDefaultShaderVars();
-    ctx->drawArrays( GL_TRIANGLES, 0, nverts );
-    ctx->popVao();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return true;
   }
 
 
@@ -136,7 +218,8 @@ public:
     params.renderCreate = Font::create;
     params.renderResize = Font::resize;
     params.renderUpdate = Font::update;
-    params.renderDraw   = Font::draw;
+    // TIPS:文字列はUI::RenderListの頂点として描くので、fontstashには描かせない
+    params.renderDraw   = nullptr;
     params.renderDelete = nullptr;
 
     params.userPtr = &gl_;
@@ -164,6 +247,58 @@ public:
     return context_;
   }
 
+
+  // テクスチャの世代
+  //   TIPS:変わったら覚えておいたテクスチャ座標は使えない
+  u_int getGeneration() const noexcept
+  {
+    return gl_.generation;
+  }
+
+  const ci::gl::Texture2dRef& getTexture() const noexcept
+  {
+    return gl_.tex;
+  }
+
+  // fonsTextIterNextなどで追加された文字をテクスチャへ転送
+  //   TIPS:それまでに溜めておいた範囲もまとめて転送する
+  void updateTexture() noexcept
+  {
+    int dirty[4];
+    if (fonsValidateTexture(context_, dirty))
+    {
+      int width, height;
+      const auto* data = fonsGetTextureData(context_, &width, &height);
+      update(&gl_, dirty, data);
+    }
+    upload(&gl_);
+  }
+
+  // PBO経由で転送するか
+  void enablePixelBuffer(const bool enable) noexcept
+  {
+    gl_.dirty.use_pbo = enable;
+    if (!enable) gl_.dirty.pbo.reset();
+  }
+
+  // 転送した量(バイト)と回数
+  size_t getUploadBytes() const noexcept
+  {
+    return gl_.dirty.upload_bytes;
+  }
+
+  u_int getUploadNum() const noexcept
+  {
+    return gl_.dirty.upload_num;
+  }
+
+  // フレームの始めに数を戻す
+  void resetUploadStats() noexcept
+  {
+    gl_.dirty.upload_bytes = 0;
+    gl_.dirty.upload_num   = 0;
+  }
+
   static unsigned int color8(const unsigned char r, const unsigned char g, const unsigned char b, const unsigned char a) noexcept
   {
     return (r) | (g << 8) | (b << 16) | (a << 24);
@@ -13,7 +13,11 @@ namespace ngs {
 //   ファイル読み込み時はこの関数でパスを取得する事
 ci::fs::path getAssetPath(const std::string& path) noexcept
 {
-#if defined (DEBUG) && defined (CINDER_MAC)
+#if defined (NGS_HEADLESS)
+  // ヘッドレス:ビルド時に指定された場所から読み込む
+  ci::fs::path full_path(std::string(NGS_ASSET_PATH) + path);
+  return full_path;
+#elif defined (DEBUG) && defined (CINDER_MAC)
   // OSX:Debug時はプロジェクトの場所からfileを読み込む
   ci::fs::path full_path(std::string(PREPRO_TO_STR(SRCROOT)) + "../assets/" + path);
   return full_path;
@@ -28,7 +32,10 @@ ci::fs::path getAssetPath(const std::string& path) noexcept
 //   ファイル書き出し時はこの関数でパスを取得する事
 ci::fs::path getDocumentPath() noexcept
 {
-#if defined(CINDER_COCOA_TOUCH)
+#if defined (NGS_HEADLESS)
+  // ヘッドレス:カレントディレクトリ
+  return ci::fs::current_path();
+#elif defined(CINDER_COCOA_TOUCH)
   // iOS:はアプリごとに用意された場所
   return ci::getDocumentsDirectory();
 #elif defined (CINDER_MAC)
@@ -5,9 +5,9 @@
 // UI::CanvasやUI::WidgetとTweenをセットにして管理する
 //
 
+#include "Params.hpp"
 #include "UICanvas.hpp"
 #include "TweenSet.hpp"
-#include "UIWidgetsFactory.hpp"
 
 
 namespace ngs {
@@ -19,10 +19,16 @@ class Scene
 
   
 public:
-  Scene(const ci::JsonTree& params, UI::WidgetsFactory& widgets_factory) noexcept
-    : canvas_(widgets_factory.construct(Params::load(params.getValueForKey<std::string>("widget")))),
+  template<typename Factory>
+  Scene(const ci::JsonTree& params, Factory& widgets_factory, const ci::vec2& size) noexcept
+    : canvas_(size),
       tween_set_(Params::load(params.getValueForKey<std::string>("tween")))
   {
+    // TIPS:WidgetはCanvasの持つ領域に作る
+    canvas_.setWidgets(widgets_factory.construct(Params::load(params.getValueForKey<std::string>("widget")),
+                                                 canvas_.getArena()));
+    // Tweenの対象を解決しておく
+    tween_set_.bind(canvas_.rootWidget());
   }
 
 
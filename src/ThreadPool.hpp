@@ -0,0 +1,194 @@
+﻿#pragma once
+
+//
+// 作業を奪い合うスレッドプール(work stealing)
+//   スレッドごとに作業キューを持ち、自分のが空になったら他所から奪う
+//   TIPS:呼び出し側のスレッドも作業に参加する
+//
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <boost/noncopyable.hpp>
+
+
+namespace ngs {
+
+class ThreadPool
+  : private boost::noncopyable
+{
+  // parallelFor一回分
+  struct Job
+  {
+    std::function<void (u_int)> func;
+    std::atomic<u_int> remain;
+  };
+
+  struct Item
+  {
+    Job* job;
+    u_int index;
+  };
+
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Item> items;
+  };
+
+  // 0番は呼び出し側のスレッド用
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+
+  // 待機中のスレッドを起こす
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cond_;
+  std::atomic<u_int> queued_;
+  bool stop_ = false;
+
+
+  // 自分のキューの後ろから取り出す
+  bool pop(const u_int queue_index, Item& item) noexcept
+  {
+    auto& queue = *queues_[queue_index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.items.empty()) return false;
+
+    item = queue.items.back();
+    queue.items.pop_back();
+    queued_ -= 1;
+    return true;
+  }
+
+  // 他所のキューの前から奪う
+  bool steal(const u_int queue_index, Item& item) noexcept
+  {
+    u_int num = u_int(queues_.size());
+    for (u_int i = 1; i < num; ++i)
+    {
+      auto& queue = *queues_[(queue_index + i) % num];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.items.empty()) continue;
+
+      item = queue.items.front();
+      queue.items.pop_front();
+      queued_ -= 1;
+      return true;
+    }
+    return false;
+  }
+
+  bool fetch(const u_int queue_index, Item& item) noexcept
+  {
+    return pop(queue_index, item) || steal(queue_index, item);
+  }
+
+  static void execute(const Item& item) noexcept
+  {
+    item.job->func(item.index);
+    item.job->remain -= 1;
+  }
+
+
+  void worker(const u_int queue_index) noexcept
+  {
+    while (true)
+    {
+      Item item;
+      if (fetch(queue_index, item))
+      {
+        execute(item);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(wait_mutex_);
+      wait_cond_.wait(lock, [this]() { return stop_ || (queued_ > 0); });
+      if (stop_) return;
+    }
+  }
+
+
+public:
+  // thread_num: 呼び出し側以外に作るスレッドの数
+  ThreadPool(const u_int thread_num = std::max(std::thread::hardware_concurrency(), 1u) - 1) noexcept
+    : queued_(0)
+  {
+    for (u_int i = 0; i <= thread_num; ++i)
+    {
+      queues_.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+
+    for (u_int i = 1; i <= thread_num; ++i)
+    {
+      threads_.emplace_back(&ThreadPool::worker, this, i);
+    }
+  }
+
+  ~ThreadPool() noexcept
+  {
+    {
+      std::lock_guard<std::mutex> lock(wait_mutex_);
+      stop_ = true;
+    }
+    wait_cond_.notify_all();
+
+    for (auto& thread : threads_)
+    {
+      thread.join();
+    }
+  }
+
+
+  // 作業に参加するスレッドの数(呼び出し側も含む)
+  u_int size() const noexcept
+  {
+    return u_int(queues_.size());
+  }
+
+  // func(0)〜func(num - 1)を並列に実行して、全部終わるまで待つ
+  template<typename F>
+  void parallelFor(const u_int num, F func) noexcept
+  {
+    if (num == 0) return;
+
+    Job job;
+    job.func   = func;
+    job.remain = num;
+
+    {
+      std::lock_guard<std::mutex> lock(wait_mutex_);
+      queued_ += num;
+    }
+
+    // 各スレッドのキューに順番に配る
+    u_int queue_num = size();
+    for (u_int i = 0; i < num; ++i)
+    {
+      auto& queue = *queues_[i % queue_num];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.items.push_back({ &job, i });
+    }
+    wait_cond_.notify_all();
+
+    // 呼び出し側も作業しながら終わるのを待つ
+    while (job.remain > 0)
+    {
+      Item item;
+      if (fetch(0, item))
+      {
+        execute(item);
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+};
+
+}
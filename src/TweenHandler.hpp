@@ -2,11 +2,15 @@
 
 //
 // TweenClipをひとまとめにして扱う
+//   対象の値はbindで解決しておく(開始時に名前で探さない)
+//   TIPS:開始時は対象をハンドルで確かめる
+//        再生中のTweenは対象のWidgetが破棄される時に取り除かれる(UI::Widget::removeTweens)
 //
 
 #include <vector>
 #include <boost/optional.hpp>
 #include "TweenClip.hpp"
+#include "UIWidget.hpp"
 
 
 namespace ngs {
@@ -14,12 +18,33 @@ namespace ngs {
 class TweenHandler
 {
   struct Property {
-    boost::optional<std::string> identifier;
-    std::string target;
+    boost::optional<Atom> identifier;
+    Atom target;
     TweenClip clip;
+
+    // bindで解決した値
+    //   TIPS:値へのポインタは破棄やWidgetの再利用で無効になるので、
+    //        Widgetのハンドルと値の番号で覚えておく
+    int param;
+    UI::WidgetHandle handle;
+    UI::Widget* widget;
   };
 
   std::vector<Property> properties_;
+
+  // bindした時の検索表とその世代
+  //   TIPS:Widgetの破棄や登録で世代が進むので、変わっていたら解決し直す
+  UI::WidgetQueryPtr query_;
+  u_int generation_ = 0;
+
+
+  template<typename T>
+  bool isBound(T* object) const noexcept
+  {
+    return query_
+           && (object->getQuery() == query_)
+           && (query_->getGeneration() == generation_);
+  }
   
 
 public:
@@ -31,34 +56,71 @@ public:
         boost::none,
         p.getValueForKey<std::string>("target"),
         TweenClip(p["clip"]),
+        -1,
+        {},
+        nullptr,
       };
 
       if (p.hasChild("id"))
       {
-        property.identifier = p.getValueForKey<std::string>("id");
+        property.identifier = Atom(p.getValueForKey<std::string>("id"));
       }
 
       properties_.push_back(std::move(property));
     }
   }
 
+  // 名前を解決しておく
+  //   識別子を指定したものは対象のWidgetまで決まる
+  //   TIPS:見つからないものはログに出して、startでは飛ばす
   template<typename T>
-  void start(const ci::TimelineRef& timeline, T* object) noexcept
+  void bind(T* object) noexcept
   {
+    query_      = object->getQuery();
+    generation_ = query_->getGeneration();
+
     for (auto& p : properties_)
     {
-      if (p.identifier)
+      p.param = T::findParam(p.target);
+      if (p.param < 0)
       {
-        T* child = object->find(*p.identifier);
-        
-        float *target = child->getParam(p.target);
-        p.clip.start(timeline, target);
+        DOUT << "TweenHandler: unknown target " << p.target << std::endl;
+        continue;
       }
-      else
+      if (!p.identifier) continue;
+
+      T* child = object->find(*p.identifier);
+      if (!child)
       {
-        float* target = object->getParam(p.target);
-        p.clip.start(timeline, target);
+        DOUT << "TweenHandler: unknown identifier " << *p.identifier << std::endl;
+        p.handle = {};
+        p.widget = nullptr;
+        continue;
       }
+
+      if (p.handle.isValid() && (p.handle != child->getHandle()))
+      {
+        DOUT << "TweenHandler: rebound " << *p.identifier << std::endl;
+      }
+      p.handle = child->getHandle();
+      p.widget = child;
+    }
+  }
+
+  template<typename T>
+  void start(const ci::TimelineRef& timeline, T* object) noexcept
+  {
+    if (!isBound(object)) bind(object);
+
+    for (auto& p : properties_)
+    {
+      if (p.param < 0) continue;
+      if (p.identifier && !p.widget) continue;
+
+      T* target = p.identifier ? p.widget : object;
+      assert(!p.identifier || (target->getHandle() == p.handle));
+      p.clip.start(timeline, target->getParam(typename T::Param(p.param)));
+      target->addTweenTimeline(timeline);
     }
   }
   
@@ -4,7 +4,7 @@
 // 複数のTweenHandlerをひとまとめにして扱う
 //
 
-#include <map>
+#include <unordered_map>
 #include "TweenHandler.hpp"
 
 
@@ -12,7 +12,7 @@ namespace ngs {
 
 class TweenSet
 {
-  std::map<std::string, TweenHandler> handlers_;
+  std::unordered_map<Atom, TweenHandler> handlers_;
 
   
 public:
@@ -21,13 +21,23 @@ public:
     for (const auto& p : params)
     {
       handlers_.emplace(std::piecewise_construct,
-                        std::forward_as_tuple(p.getValueForKey<std::string>("id")),
+                        std::forward_as_tuple(Atom(p.getValueForKey<std::string>("id"))),
                         std::forward_as_tuple(Params::load(p.getValueForKey<std::string>("handle"))));
     }
   }
 
+  // 全TweenHandlerの名前を解決
   template<typename T>
-  void start(const std::string& id, const ci::TimelineRef& timeline, T* object) noexcept
+  void bind(T* object) noexcept
+  {
+    for (auto& h : handlers_)
+    {
+      h.second.bind(object);
+    }
+  }
+
+  template<typename T>
+  void start(const Atom& id, const ci::TimelineRef& timeline, T* object) noexcept
   {
     auto& handle = handlers_.at(id);
     handle.start(timeline, object);
@@ -5,8 +5,13 @@
 //  TODO:CameraPerspにも対応
 //
 
+#include <cmath>
 #include <cinder/Camera.h>
 #include "UIWidget.hpp"
+#include "UIWidgetArena.hpp"
+#include "UILayout.hpp"
+#include "UITouchIndex.hpp"
+#include "UIRenderList.hpp"
 
 
 namespace ngs { namespace UI {
@@ -18,7 +23,141 @@ class Canvas
   ci::vec2 size_;
   ci::Rectf rect_;
 
-  UI::WidgetPtr root_widget_;
+  // TIPS:Widgetより先に破棄されないよう最初に置く
+  WidgetArena arena_;
+
+  Widget* root_widget_ = nullptr;
+
+  // 位置・サイズ計算
+  Layout layout_;
+  bool resized_ = false;
+
+  // UI::Layoutで計算し直した範囲
+  //   TIPS:タッチ判定と描画で別々に使うので、受け取って溜めておく
+  struct Changes
+  {
+    std::vector<std::pair<u_int, u_int>> ranges;
+    bool all = true;
+
+    void add(const Layout& layout) noexcept
+    {
+      if (all) return;
+
+      // TIPS:範囲が増えすぎたら全部変わった扱い
+      const auto& changed = layout.getChangedRanges();
+      if (layout.isAllChanged() || ((ranges.size() + changed.size()) >= 256))
+      {
+        all = true;
+        ranges.clear();
+        return;
+      }
+      ranges.insert(std::end(ranges), std::begin(changed), std::end(changed));
+    }
+
+    void clear() noexcept
+    {
+      all = false;
+      ranges.clear();
+    }
+  };
+  Changes touch_changes_;
+  Changes draw_changes_;
+
+  // 並列計算用
+  std::shared_ptr<ThreadPool> thread_pool_;
+
+  // タッチ判定用
+  TouchIndex touch_index_;
+  bool touch_index_rebuild_ = true;
+  std::vector<u_int> touch_candidates_;
+
+  // touchBeganでイベントを送る先
+  //   TIPS:イベント処理で破棄されても大丈夫なように、送る前にハンドルにしておく
+  std::vector<std::pair<WidgetHandle, ci::Rectf>> touch_targets_;
+
+  // タッチイベントを送っている最中の破棄
+  //   階層からはすぐに外し、破棄は送り終えてから行う
+  u_int dispatching_ = 0;
+  std::vector<WidgetHandle> destroy_pending_;
+
+  // タッチごとにBEGANを受け取ったWidget
+  //   MOVED、ENDEDはこれらのWidgetにだけ送る
+  //   TIPS:途中で破棄されても大丈夫なようにハンドルで持つ
+  std::map<uint32_t, std::vector<WidgetHandle>> captures_;
+
+  // 描画の間引き
+  //   clip_childrenのWidgetの部分木の終端と、それまでの切り抜き範囲
+  std::vector<std::pair<u_int, ci::Rectf>> clip_stack_;
+  u_int drawn_num_  = 0;
+  u_int culled_num_ = 0;
+
+  // 描画内容の記録
+  RenderList render_list_;
+
+  // 部分木をテクスチャに描くWidget(cache_as_layer)の記録
+  //   TIPS:記録し直しても同じWidgetなら同じものを使う(UI::Drawerが版を比べて描き直す)
+  struct Layer
+  {
+    WidgetHandle handle;
+    u_int root = 0;             // UI::Layout上の番号
+    ci::Rectf rect;             // テクスチャに描く範囲
+    RenderList list;
+    bool used = false;
+  };
+  std::unordered_map<u_int, std::unique_ptr<Layer>> layers_;
+
+  // Widgetごとの描画するかどうかの判定
+  //   TIPS:変わった所だけ判定し直し、前回と同じなら記録を書き換えるだけで済ませる
+  //   TIPS:recordが記録した回数と違うものは判定していない(毎回消さなくてよい)
+  struct DrawEntry
+  {
+    ci::Rectf clip;                 // 判定に使った切り抜き範囲
+    u_int record       = 0;         // 判定した時の記録の回数
+    bool drawn         = false;     // 描画した
+    bool skip_children = false;     // 子供は辿らなかった
+    bool clip_children = false;
+    bool layer_root    = false;     // 部分木をレイヤーに描く
+    Layer* layer = nullptr;         // 記録先のレイヤー
+  };
+  std::vector<DrawEntry> draw_entries_;
+  u_int record_num_ = 0;
+
+
+  // タッチ中のWidget
+  //   破棄されたか、階層から外れていたらnullptr
+  Widget* capturedWidget(const WidgetHandle& handle) const noexcept
+  {
+    auto* widget = arena_.get(handle);
+    if (!widget) return nullptr;
+
+    u_int index = widget->getLayoutIndex();
+    if ((index >= layout_.size()) || (layout_.widget(index) != widget)) return nullptr;
+
+    // TIPS:イベント処理中に外されたものは、階層を作り直すまでUI::Layoutに残っている
+    auto* top = widget;
+    while (top->getParent()) top = top->getParent();
+    return (top == root_widget_) ? widget : nullptr;
+  }
+
+  // タッチイベントを送り始める
+  void beginDispatch() noexcept
+  {
+    dispatching_ += 1;
+  }
+
+  // 送り終えたら、その間に破棄を頼まれたWidgetを破棄
+  void endDispatch() noexcept
+  {
+    dispatching_ -= 1;
+    if (dispatching_) return;
+
+    for (const auto& handle : destroy_pending_)
+    {
+      // TIPS:同じWidgetを二度頼まれていたら、二度目は見つからない
+      if (auto* widget = arena_.get(handle)) arena_.destroy(widget);
+    }
+    destroy_pending_.clear();
+  }
 
 
   void setupCamera(const ci::vec2& size) noexcept
@@ -33,72 +172,564 @@ class Canvas
     rect_ = ci::Rectf(-size_.x / 2.0f, -size_.y / 2.0f, size_.x / 2.0f, size_.y / 2.0f);
   }
 
+  // 計算し直した範囲をタッチ判定と描画へ渡す
+  void collectChanges() noexcept
+  {
+    touch_changes_.add(layout_);
+    draw_changes_.add(layout_);
+    layout_.clearChanged();
+  }
+
+
+  // 部分木[begin, end)の各Widgetを描画するか判定する
+  //   layer_end: レイヤーの途中から始める時はその部分木の終端
+  //   visit(index, entry): falseを返すと打ち切る
+  //   culled: 間引いた数を足す
+  //   TIPS:画面外や、切り抜く親の範囲外の部分木は辿らない
+  //        レイヤーの中のレイヤーは普通に描く
+  template<typename F>
+  bool traverse(const u_int begin, const u_int end, ci::Rectf clip, u_int layer_end, u_int& culled, F visit) noexcept
+  {
+    clip_stack_.clear();
+
+    u_int index = begin;
+    while (index < end)
+    {
+      // 切り抜く親の部分木を抜けた
+      while (!clip_stack_.empty() && (index >= clip_stack_.back().first))
+      {
+        clip = clip_stack_.back().second;
+        clip_stack_.pop_back();
+      }
+
+      auto* widget = layout_.widget(index);
+      u_int subtree_end = layout_.subtreeEnd(index);
+
+      DrawEntry entry;
+      entry.clip          = clip;
+      entry.record        = record_num_;
+      entry.clip_children = widget->isClipChildren();
+
+      if (!widget->isDisplay())
+      {
+        entry.skip_children = true;
+        if (!visit(index, entry)) return false;
+        index = subtree_end;
+        continue;
+      }
+
+      if (!isOverlapped(layout_.subtreeBounds(index), clip))
+      {
+        // 子供も含めて範囲外
+        entry.skip_children = true;
+        if (!visit(index, entry)) return false;
+        culled += subtree_end - index;
+        index = subtree_end;
+        continue;
+      }
+
+      auto bounds = normalized(layout_.worldRect(index));
+      if (isOverlapped(bounds, clip))
+      {
+        entry.drawn = true;
+      }
+      else if (widget->isClipChildren())
+      {
+        // 切り抜く範囲が無いので子供も描画されない
+        entry.skip_children = true;
+      }
+
+      if (widget->isCacheAsLayer() && !entry.skip_children && (index >= layer_end))
+      {
+        entry.layer_root = true;
+        layer_end = subtree_end;
+      }
+
+      if (!visit(index, entry)) return false;
+
+      if (entry.skip_children)
+      {
+        culled += subtree_end - index;
+        index = subtree_end;
+        continue;
+      }
+      if (!entry.drawn) culled += 1;
+
+      if (widget->isClipChildren() && ((index + 1) < subtree_end))
+      {
+        clip_stack_.push_back({ subtree_end, clip });
+        clip = ci::Rectf(std::max(clip.x1, bounds.x1), std::max(clip.y1, bounds.y1),
+                         std::min(clip.x2, bounds.x2), std::min(clip.y2, bounds.y2));
+      }
+      index += 1;
+    }
+    return true;
+  }
+
+  // 描画内容が変わったWidgetを辿って印を消す
+  //   func(index): falseを返すと以降は呼ばない(印は消す)
+  //   TIPS:印の付いていない部分木は辿らない
+  template<typename F>
+  bool visitDrawDirty(F func) noexcept
+  {
+    bool result = true;
+
+    u_int num = layout_.size();
+    u_int index = 0;
+    while (index < num)
+    {
+      auto* widget = layout_.widget(index);
+      bool dirty   = widget->isDrawDirty();
+      bool descend = widget->hasDrawDirtyDescendant();
+      widget->clearDrawDirty();
+
+      if (dirty && result) result = func(index);
+      index = descend ? (index + 1) : layout_.subtreeEnd(index);
+    }
+    return result;
+  }
+
+  void recordWidget(RenderList& list, const u_int index) noexcept
+  {
+    list.beginWidget();
+    layout_.widget(index)->draw(list, layout_.worldRect(index), layout_.worldScale(index));
+  }
+
+  // 記録先と、その中での番号
+  RenderList& targetList(const DrawEntry& entry) noexcept
+  {
+    return entry.layer ? entry.layer->list : render_list_;
+  }
+
+  static u_int targetIndex(const DrawEntry& entry, const u_int index) noexcept
+  {
+    return entry.layer ? (index - entry.layer->root) : index;
+  }
+
+  // レイヤーの範囲
+  //   部分木の範囲を切り抜いて、ピクセル単位に広げる
+  ci::Rectf layerRect(const u_int index, const ci::Rectf& clip) const noexcept
+  {
+    auto bounds = layout_.subtreeBounds(index);
+    return ci::Rectf(std::floor(std::max(bounds.x1, clip.x1)), std::floor(std::max(bounds.y1, clip.y1)),
+                     std::ceil(std::min(bounds.x2, clip.x2)),  std::ceil(std::min(bounds.y2, clip.y2)));
+  }
+
+  static bool isSameRect(const ci::Rectf& a, const ci::Rectf& b) noexcept
+  {
+    return (a.x1 == b.x1) && (a.y1 == b.y1) && (a.x2 == b.x2) && (a.y2 == b.y2);
+  }
+
+  // レイヤーの記録を始める
+  Layer* beginLayer(const u_int index, const ci::Rectf& clip) noexcept
+  {
+    const auto& handle = layout_.widget(index)->getHandle();
+    auto& layer = layers_[handle.index];
+    if (!layer || (layer->handle != handle))
+    {
+      layer.reset(new Layer());
+      layer->handle = handle;
+    }
+
+    layer->root = index;
+    layer->rect = layerRect(index, clip);
+    layer->used = true;
+    layer->list.begin(layout_.subtreeEnd(index) - index);
+    return layer.get();
+  }
+
+  // 全部記録し直す
+  void record() noexcept
+  {
+    visitDrawDirty([](const u_int) { return true; });
+
+    u_int num = layout_.size();
+    draw_entries_.resize(num);
+    record_num_ += 1;
+    render_list_.begin(num);
+
+    for (auto& layer : layers_)
+    {
+      layer.second->used = false;
+    }
+
+    drawn_num_  = 0;
+    culled_num_ = 0;
+    Layer* layer = nullptr;
+    u_int layer_end = 0;
+    traverse(0, num, rect_, 0, culled_num_, [&](const u_int index, DrawEntry& entry) {
+        if (layer && (index >= layer_end))
+        {
+          layer->list.end();
+          layer = nullptr;
+        }
+        if (entry.layer_root)
+        {
+          // TIPS:元の記録にはレイヤーを貼る四角形を置く
+          layer = beginLayer(index, entry.clip);
+          layer_end = layout_.subtreeEnd(index);
+          render_list_.beginWidget();
+          render_list_.addLayer(layer->list, layer->rect);
+          render_list_.endWidget(index);
+        }
+
+        entry.layer = layer;
+        draw_entries_[index] = entry;
+        if (entry.drawn)
+        {
+          auto& list = targetList(entry);
+          recordWidget(list, index);
+          list.endWidget(targetIndex(entry, index));
+          drawn_num_ += 1;
+        }
+        return true;
+      });
+    if (layer) layer->list.end();
+
+    render_list_.end();
+
+    // 使わなかったレイヤーを捨てる
+    for (auto it = std::begin(layers_); it != std::end(layers_); )
+    {
+      if (it->second->used) ++it;
+      else                  it = layers_.erase(it);
+    }
+  }
+
+  // 部分木[begin, end)の記録を書き換える
+  //   描画するかどうかが前回と変わったらfalse
+  bool rerecord(const u_int begin, const u_int end) noexcept
+  {
+    // TIPS:前回判定していない(親ごと間引いた)所は切り抜く範囲が分からない
+    if ((begin >= draw_entries_.size()) || (draw_entries_[begin].record != record_num_)) return false;
+
+    // TIPS:レイヤーの途中から始める時は、その中にレイヤーは作らない
+    const auto* layer = draw_entries_[begin].layer;
+    u_int layer_end = (layer && (layer->root != begin)) ? layout_.subtreeEnd(layer->root) : 0;
+
+    u_int culled = 0;
+    return traverse(begin, end, draw_entries_[begin].clip, layer_end, culled, [this](const u_int index, DrawEntry& entry) {
+        auto& prev = draw_entries_[index];
+        if ((prev.record != entry.record) || (prev.drawn != entry.drawn)
+            || (prev.skip_children != entry.skip_children) || (prev.clip_children != entry.clip_children)
+            || (prev.layer_root != entry.layer_root))
+        {
+          return false;
+        }
+        entry.layer = prev.layer;
+        prev = entry;
+
+        // レイヤーの範囲が変わったら作り直し
+        if (entry.layer
+            && !isSameRect(layerRect(entry.layer->root, draw_entries_[entry.layer->root].clip), entry.layer->rect))
+        {
+          return false;
+        }
+        if (!entry.drawn) return true;
+
+        auto& list = targetList(entry);
+        recordWidget(list, index);
+        return list.replaceWidget(targetIndex(entry, index));
+      });
+  }
+
+  // 変わったWidgetの記録だけ書き換える
+  //   書き換えられなければfalse
+  bool updateRenderList() noexcept
+  {
+    // TIPS:変わった範囲が広い時は全部記録し直した方が早い
+    u_int changed_num = 0;
+    for (const auto& range : draw_changes_.ranges)
+    {
+      changed_num += range.second - range.first;
+    }
+    if (changed_num > (layout_.size() / 4)) return false;
+
+    // 位置・サイズが変わった部分木
+    for (const auto& range : draw_changes_.ranges)
+    {
+      if (!rerecord(range.first, range.second))
+      {
+        return false;
+      }
+    }
+
+    // 色や描画用の値が変わったWidget
+    return visitDrawDirty([this](const u_int index) {
+        return rerecord(index, index + 1);
+      });
+  }
+
 
 public:
-  Canvas() noexcept
+  // TIPS:ウインドウに依存しないようにサイズは外から与える
+  Canvas(const ci::vec2& size) noexcept
   {
-    setupCamera(ci::app::getWindowSize());
+    setupCamera(size);
   }
 
-  Canvas(const UI::WidgetPtr& root_widget) noexcept
+
+
+  // Widgetの置き場所
+  //   このCanvasで使うWidgetはここから作る
+  WidgetArena& getArena() noexcept
   {
-    setupCamera(ci::app::getWindowSize());
-    root_widget_ = root_widget;
+    return arena_;
   }
-  
 
-  void setWidgets(const UI::WidgetPtr& root_widget) noexcept
+  void setWidgets(Widget* root_widget) noexcept
   {
     root_widget_ = root_widget;
+    layout_.compile(root_widget_, rect_);
+    touch_index_rebuild_ = true;
+    collectChanges();
   }
 
   Widget* rootWidget() noexcept
   {
-    return root_widget_.get();
+    return root_widget_;
   }
 
-  const WidgetPtr& rootWidgetPtr() noexcept
+  // Widgetを部分木ごと破棄
+  //   タッチイベントの処理中なら、送り終えてから破棄する
+  //   TIPS:rootは破棄できない
+  void destroyWidget(Widget* widget) noexcept
   {
-    return root_widget_;
+    assert(widget != root_widget_);
+    if (dispatching_)
+    {
+      if (auto* parent = widget->getParent()) parent->removeChild(widget);
+      destroy_pending_.push_back(widget->getHandle());
+      return;
+    }
+    arena_.destroy(widget);
   }
   
-  Widget* findWidget(const std::string& identifier) noexcept
+  Widget* findWidget(const Atom& identifier) noexcept
   {
     return root_widget_->find(identifier);
   }
 
+  // "root/panel/button1"のような経路で探す
+  Widget* findWidgetPath(const std::string& path) noexcept
+  {
+    return root_widget_->findPath(path);
+  }
+
 
   void resize(const ci::vec2& size) noexcept
   {
     setupCamera(size);
+
+    // TIPS:全Widgetの再計算が必要
+    resized_ = true;
+  }
+
+
+  // Widgetの位置・サイズを更新
+  //   変更が無ければほとんど何もしない
+  void updateLayout() noexcept
+  {
+    if (root_widget_->isTreeChanged())
+    {
+      // 階層が変わったので作り直し
+      layout_.compile(root_widget_, rect_);
+      touch_index_rebuild_ = true;
+    }
+    else
+    {
+      layout_.update(rect_, resized_);
+    }
+    resized_ = false;
+    collectChanges();
+  }
+
+  // 位置・サイズの並列計算
+  //   Widgetの数がthreshold未満の時は並列計算しない
+  //   poolがnullptrなら無効
+  void enableParallelLayout(const std::shared_ptr<ThreadPool>& pool, const u_int threshold = 4096) noexcept
+  {
+    thread_pool_ = pool;
+    layout_.enableParallel(thread_pool_.get(), threshold);
+  }
+
+  const Layout& getLayout() const noexcept
+  {
+    return layout_;
+  }
+
+
+  // タッチ判定用の空間分割を更新
+  //   作り直すのは階層や画面サイズが変わった時だけ
+  //   TIPS:タッチした時にまとめて反映する
+  void updateTouchIndex() noexcept
+  {
+    bool rebuild = touch_index_rebuild_ || touch_changes_.all || root_widget_->isInputWatched();
+    if (!rebuild && root_widget_->isInputChanged())
+    {
+      // TIPS:有効・表示などが変わった部分木だけ登録し直す
+      rebuild = !touch_index_.refresh(layout_);
+    }
+
+    if (rebuild)
+    {
+      if (root_widget_->isInputWatched())
+      {
+        root_widget_->recountTouchable();
+      }
+      touch_index_.rebuild(layout_, rect_);
+      touch_index_rebuild_ = false;
+    }
+    else
+    {
+      for (const auto& range : touch_changes_.ranges)
+      {
+        touch_index_.update(layout_, range.first, range.second);
+      }
+    }
+    touch_changes_.clear();
   }
 
 
   void touchBegan(const Touch& touch)
   {
-    ci::vec2 scale{ 1.0f, 1.0f };
-    root_widget_->touchBegan(touch, rect_, scale);
+    updateLayout();
+    updateTouchIndex();
+
+    // TIPS:タッチ位置の升目にいるWidgetだけ調べる
+    touch_index_.query(touch.getPos(), touch_candidates_);
+
+    // TIPS:イベント処理中にtouchBeganが呼ばれても大丈夫なように借りてくる
+    auto targets = std::move(touch_targets_);
+    targets.clear();
+    for (auto index : touch_candidates_)
+    {
+      targets.emplace_back(layout_.widget(index)->getHandle(), layout_.worldRect(index));
+    }
+
+    auto captured = std::move(captures_[touch.getId()]);
+    captured.clear();
+    beginDispatch();
+    for (const auto& target : targets)
+    {
+      auto* widget = capturedWidget(target.first);
+      if (!widget) continue;
+
+      widget->touchBegan(touch, target.second);
+      if (widget->isTouching())
+      {
+        captured.push_back(target.first);
+      }
+    }
+    endDispatch();
+
+    captures_[touch.getId()] = std::move(captured);
+    touch_targets_ = std::move(targets);
   }
 
+  // TIPS:Widgetの番号は階層の作り直しで変わるので都度取得する
   void touchMoved(const Touch& touch)
   {
-    ci::vec2 scale{ 1.0f, 1.0f };
-    root_widget_->touchMoved(touch, rect_, scale);
+    auto it = captures_.find(touch.getId());
+    if (it == std::end(captures_)) return;
+
+    updateLayout();
+    beginDispatch();
+    for (const auto& handle : it->second)
+    {
+      auto* widget = capturedWidget(handle);
+      if (!widget) continue;
+
+      widget->touchMoved(touch, layout_.worldRect(widget->getLayoutIndex()));
+    }
+    endDispatch();
   }
 
   void touchEnded(const Touch& touch)
   {
-    ci::vec2 scale{ 1.0f, 1.0f };
-    root_widget_->touchEnded(touch, rect_, scale);
+    auto it = captures_.find(touch.getId());
+    if (it == std::end(captures_)) return;
+
+    // TIPS:イベント処理中に同じタッチが来ても大丈夫なように先に外す
+    auto captured = std::move(it->second);
+    captures_.erase(it);
+
+    updateLayout();
+    beginDispatch();
+    for (const auto& handle : captured)
+    {
+      auto* widget = capturedWidget(handle);
+      if (!widget) continue;
+
+      widget->touchEnded(touch, layout_.worldRect(widget->getLayoutIndex()));
+    }
+    endDispatch();
+  }
+
+
+  // 描画用のカメラ
+  const ci::CameraOrtho& getCamera() const noexcept
+  {
+    return camera_;
+  }
+
+  // 矩形同士が重なっているか
+  // TIPS:大きさ0でも範囲内なら描画する(文字列など)
+  static bool isOverlapped(const ci::Rectf& a, const ci::Rectf& b) noexcept
+  {
+    return (a.x1 <= b.x2) && (b.x1 <= a.x2) && (a.y1 <= b.y2) && (b.y1 <= a.y2);
   }
 
+  static ci::Rectf normalized(const ci::Rectf& rect) noexcept
+  {
+    return ci::Rectf(std::min(rect.x1, rect.x2), std::min(rect.y1, rect.y2),
+                     std::max(rect.x1, rect.x2), std::max(rect.y1, rect.y2));
+  }
 
+  // 描画内容を記録する
+  //   前回から変わったWidgetの記録だけ書き換え、変化が無ければ何もしない
+  //   TIPS:実際の描画は記録を使ってUI::Drawerが行う
+  //        カメラの設定は呼び出し側で行う
   void draw() noexcept
   {
-    ci::gl::setMatrices(camera_);
+    updateLayout();
+    render_list_.resetRecordedNum();
+
+    if (draw_changes_.all || !updateRenderList() || render_list_.isRecordRequested())
+    {
+      record();
+
+      // TIPS:途中でフォントのテクスチャが作り直されたらもう一度
+      if (render_list_.isRecordRequested()) record();
+    }
+    draw_changes_.clear();
+  }
+
+  RenderList& getRenderList() noexcept
+  {
+    return render_list_;
+  }
 
-    ci::vec2 scale{ 1.0f, 1.0f };
-    root_widget_->draw(rect_, scale);
+  // 使っているレイヤーの数
+  u_int getLayerNum() const noexcept
+  {
+    return u_int(layers_.size());
+  }
+
+  const RenderList& getRenderList() const noexcept
+  {
+    return render_list_;
+  }
+
+  // 最後に全部記録した時に描画した数と間引いた数
+  u_int getDrawnNum() const noexcept
+  {
+    return drawn_num_;
+  }
+
+  u_int getCulledNum() const noexcept
+  {
+    return culled_num_;
   }
 
 };
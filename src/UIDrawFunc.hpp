@@ -0,0 +1,102 @@
+﻿#pragma once
+
+//
+// UI::Widgetの描画関数
+//   種類ごとに番号を割り振り、関数ポインタと呼び出し先を組にして持つ
+//   std::functionを使わないので、呼び出しは間接呼び出し一回で済む
+//   描画関数は描画内容をUI::RenderListに記録する
+//   TIPS:組み込みの種類はDrawTypeの順に登録する
+//        独自の種類はその後ろに追加される
+//
+
+#include <vector>
+#include <unordered_map>
+#include "Atom.hpp"
+
+
+namespace ngs { namespace UI {
+
+class Widget;
+class RenderList;
+
+// 組み込みの種類
+enum DrawType {
+  DRAW_BLANK,
+  DRAW_RECT,
+  DRAW_FILL_RECT,
+  DRAW_ROUNDED_RECT,
+  DRAW_ROUNDED_FILL_RECT,
+  DRAW_IMAGE,
+  DRAW_TEXT,
+
+  DRAW_TYPE_NUM
+};
+
+struct DrawFunc
+{
+  using Func = void (*)(void* context, RenderList& list, const Widget& widget, const ci::Rectf& rect, const ci::vec2& scale);
+
+  Func func     = nullptr;
+  void* context = nullptr;
+  u_int type    = DRAW_BLANK;
+
+
+  void operator()(RenderList& list, const Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) const noexcept
+  {
+    func(context, list, widget, rect, scale);
+  }
+};
+
+
+// 名前から描画関数を引く表
+class DrawFuncTable
+{
+  std::vector<DrawFunc> funcs_;
+  std::unordered_map<Atom, u_int> types_;
+
+
+public:
+  DrawFuncTable() = default;
+
+
+  // 登録して種類の番号を返す
+  //   同じ名前は上書き
+  u_int add(const Atom& name, const DrawFunc::Func func, void* context) noexcept
+  {
+    auto it = types_.find(name);
+    u_int type = (it != std::end(types_)) ? it->second
+                                          : u_int(funcs_.size());
+    if (type == funcs_.size())
+    {
+      funcs_.push_back(DrawFunc());
+      types_.insert({ name, type });
+    }
+
+    funcs_[type] = { func, context, type };
+    return type;
+  }
+
+  bool has(const Atom& name) const noexcept
+  {
+    return types_.count(name) > 0;
+  }
+
+  const DrawFunc& get(const Atom& name) const noexcept
+  {
+    assert(has(name));
+    return funcs_[types_.at(name)];
+  }
+
+  const DrawFunc& get(const u_int type) const noexcept
+  {
+    return funcs_[type];
+  }
+
+  u_int size() const noexcept
+  {
+    return u_int(funcs_.size());
+  }
+
+};
+
+} }
@@ -5,9 +5,16 @@
 // FIXME:全部入り・・・
 //
 
+#include <cstddef>
 #include <boost/noncopyable.hpp>
+#include <cinder/ImageIo.h>
+#include <cinder/Camera.h>
 #include "UIWidget.hpp"
+#include "UIRenderList.hpp"
+#include "UILayerCache.hpp"
+#include "UITextureAtlas.hpp"
 #include "Font.hpp"
+#include "Misc.hpp"
 
 
 namespace ngs { namespace UI {
@@ -18,10 +25,75 @@ class Drawer
   // 文字列描画用
   Font font_ = { 1024, 1024, FONS_ZERO_BOTTOMLEFT };
 
+  // 画像
+  TextureAtlas atlas_;
+
   // シェーダー
-  ci::gl::GlslProgRef color_shader_   = createShader("color", "color");
+  // TIPS:一色塗り潰しもUI::TextureAtlasの白いテクセルを貼ってtextureで描く
   ci::gl::GlslProgRef texture_shader_ = createShader("texture", "texture");
   ci::gl::GlslProgRef font_shader_ =    createShader("font", "font");
+  ci::gl::GlslProgRef rounded_shader_ = createShader("rounded", "rounded");
+
+  // UI::RenderListの頂点を描画するシェーダー
+  enum { BATCH_TEXTURE, BATCH_FONT, BATCH_ROUNDED, BATCH_SHADER_NUM };
+
+  struct VertexBuffer
+  {
+    ci::gl::VboRef vbo;
+    // TIPS:シェーダーごとに頂点属性の位置が違うのでVAOも別々
+    ci::gl::VaoRef vao[BATCH_SHADER_NUM];
+  };
+
+  // 角丸矩形のインスタンス描画に使う(0, 0)-(1, 1)の四角形
+  ci::gl::VboRef rounded_quad_ = createRoundedQuad();
+  VertexBuffer batch_buffer_;
+  u_int batch_draw_num_ = 0;
+
+  // レイヤー
+  //   TIPS:描き直す時だけ頂点を転送するので、バッファは別
+  LayerCache layer_cache_ = LayerCache(32 * 1024 * 1024);
+  VertexBuffer layer_buffer_;
+
+
+  // 描画関数が読む値の番号
+  // TIPS:生成時にgetSchemaの順番に並べ替えてある
+  enum { RECT_LINE_WIDTH };
+  enum { ROUNDED_CORNER_RADIUS, ROUNDED_LINE_WIDTH };
+  enum { IMAGE_TEXTURE, IMAGE_UV };
+  enum { TEXT_FONT, TEXT_SIZE, TEXT_TEXT, TEXT_ALIGN_V, TEXT_ALIGN_H };
+
+
+  // 描画関数の表
+  DrawFuncTable draw_funcs_;
+
+  // 文字列描画の結果
+  // TIPS:UI::WidgetArena上の番号ごとに持つ
+  struct TextCache
+  {
+    u_int generation = 0;       // Widgetの世代
+    u_int atlas = 0;            // フォントのテクスチャの世代
+
+    std::string font;
+    float size = 0.0f;
+    std::string text;
+    Atom align_v;
+    Atom align_h;
+    ci::Rectf rect;
+    unsigned int color = 0;
+
+    std::vector<RenderList::Vertex> vertices;
+  };
+
+  std::vector<TextCache> text_cache_;
+
+  // メンバ関数を関数ポインタで呼べるようにする
+  using Member = void (Drawer::*)(RenderList&, const UI::Widget&, const ci::Rectf&, const ci::vec2&);
+
+  template<Member member>
+  static void call(void* context, RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  {
+    (static_cast<Drawer*>(context)->*member)(list, widget, rect, scale);
+  }
 
 
   static void setShader(const ci::gl::GlslProgRef& shader)
@@ -33,170 +105,501 @@ class Drawer
 
     shader->bind();
   }
+
+  const ci::gl::GlslProgRef& batchShader(const u_int shader) const noexcept
+  {
+    switch (shader)
+    {
+    case BATCH_FONT:    return font_shader_;
+    case BATCH_ROUNDED: return rounded_shader_;
+    default:            return texture_shader_;
+    }
+  }
+
+  static ci::gl::VboRef createRoundedQuad() noexcept
+  {
+    const ci::vec2 quad[] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+    return ci::gl::Vbo::create(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+  }
+
+  // 角丸矩形のVAO
+  //   インスタンスの値の位置は描画ごとに指定する(setRoundedInstance)
+  void createRoundedVao(VertexBuffer& buffer) noexcept
+  {
+    buffer.vao[BATCH_ROUNDED] = ci::gl::Vao::create();
+    ci::gl::ScopedVao vao(buffer.vao[BATCH_ROUNDED]);
+
+    {
+      ci::gl::ScopedBuffer vbo(rounded_quad_);
+      int loc = rounded_shader_->getAttribSemanticLocation(ci::geom::Attrib::POSITION);
+      ci::gl::enableVertexAttribArray(loc);
+      ci::gl::vertexAttribPointer(loc, 2, GL_FLOAT, GL_FALSE, sizeof(ci::vec2), nullptr);
+    }
+
+    for (const auto* name : { "iRect", "iColor", "iShape" })
+    {
+      int loc = rounded_shader_->getAttribLocation(name);
+      if (loc < 0) continue;
+
+      ci::gl::enableVertexAttribArray(loc);
+      ci::gl::vertexAttribDivisor(loc, 1);
+    }
+  }
+
+  // インスタンスの値をfirst番目の頂点から読むようにする
+  void setRoundedInstance(const VertexBuffer& buffer, const u_int first) noexcept
+  {
+    ci::gl::ScopedBuffer vbo(buffer.vbo);
+    size_t base = first * sizeof(RenderList::Vertex);
+
+    auto attrib = [this, base](const char* name, const GLint size, const GLenum type,
+                               const GLboolean normalized, const size_t offset) {
+      int loc = rounded_shader_->getAttribLocation(name);
+      if (loc < 0) return;
+
+      ci::gl::vertexAttribPointer(loc, size, type, normalized, sizeof(RenderList::Rounded), (const void*)(base + offset));
+    };
+
+    attrib("iRect",  4, GL_FLOAT,         GL_FALSE, offsetof(RenderList::Rounded, rect));
+    attrib("iColor", 4, GL_UNSIGNED_BYTE, GL_TRUE,  offsetof(RenderList::Rounded, color));
+    attrib("iShape", 2, GL_FLOAT,         GL_FALSE, offsetof(RenderList::Rounded, corner_radius));
+  }
+
+  // 頂点バッファを確保してVAOを設定
+  void createVertexBuffer(VertexBuffer& buffer, const size_t bytes) noexcept
+  {
+    buffer.vbo = ci::gl::Vbo::create(GL_ARRAY_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW);
+    createRoundedVao(buffer);
+
+    for (u_int i = 0; i < BATCH_SHADER_NUM; ++i)
+    {
+      if (i == BATCH_ROUNDED) continue;
+
+      const auto& shader = batchShader(i);
+
+      buffer.vao[i] = ci::gl::Vao::create();
+      ci::gl::ScopedVao vao(buffer.vao[i]);
+      ci::gl::ScopedBuffer vbo(buffer.vbo);
+
+      auto attrib = [&shader](const ci::geom::Attrib semantic, const GLint size, const GLenum type,
+                              const GLboolean normalized, const size_t offset) {
+        int loc = shader->getAttribSemanticLocation(semantic);
+        if (loc < 0) return;
+
+        ci::gl::enableVertexAttribArray(loc);
+        ci::gl::vertexAttribPointer(loc, size, type, normalized, sizeof(RenderList::Vertex), (const void*)offset);
+      };
+
+      attrib(ci::geom::Attrib::POSITION,    2, GL_FLOAT,         GL_FALSE, offsetof(RenderList::Vertex, pos));
+      attrib(ci::geom::Attrib::TEX_COORD_0, 2, GL_FLOAT,         GL_FALSE, offsetof(RenderList::Vertex, uv));
+      attrib(ci::geom::Attrib::COLOR,       4, GL_UNSIGNED_BYTE, GL_TRUE,  offsetof(RenderList::Vertex, color));
+    }
+  }
   
 
   // 何も描画しない
-  void blank(const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  void blank(RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
   {
   }
 
   // 枠だけ描画
-  void rect(const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  void rect(RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
   {
-    setShader(color_shader_);
-    
-    // FIXME:仮描画
-    ci::gl::color(widget.getColor());
-    float line_width = widget.at<float>("line_width");
-    ci::gl::drawStrokedRect(rect, line_width);
+    float line_width = widget.property<float>(RECT_LINE_WIDTH);
+    const auto& white = atlas_.white();
+    list.addStroked(BATCH_TEXTURE, white.texture, rect, line_width, white.uv,
+                    RenderList::packColor(widget.getColor()));
   }
 
   // 一色塗り潰し
-  void fillRect(const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  void fillRect(RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
   {
-    setShader(color_shader_);
-
-    // FIXME:仮描画
-    ci::gl::color(widget.getColor());
-    ci::gl::drawSolidRect(rect);
+    const auto& white = atlas_.white();
+    list.add(BATCH_TEXTURE, white.texture, rect, white.uv,
+             RenderList::packColor(widget.getColor()));
   }
 
   // 角丸矩形
-  void roundedRect(const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  //   TIPS:SDFで描くので頂点は作らない
+  void roundedRect(RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
   {
-    setShader(color_shader_);
-
-    // FIXME:仮描画
-    ci::gl::color(widget.getColor());
-
-    // FIXME:線の幅を指定できない
-    // float line_width    = widget.at<float>("line_width");
-    // ci::gl::lineWidth(line_width);
-  
-    float corner_radius = widget.at<float>("corner_radius");
-    ci::gl::drawStrokedRoundedRect(rect, corner_radius);
+    list.addRounded(BATCH_ROUNDED, rect,
+                    widget.property<float>(ROUNDED_CORNER_RADIUS), widget.property<float>(ROUNDED_LINE_WIDTH),
+                    RenderList::packColor(widget.getColor()));
   }
 
   // 一色塗り潰し(角丸)
-  void roundedFillRect(const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  void roundedFillRect(RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
   {
-    setShader(color_shader_);
-
-    // FIXME:仮描画
-    ci::gl::color(widget.getColor());
-    float corner_radius = widget.at<float>("corner_radius");
-    ci::gl::drawSolidRoundedRect(rect, corner_radius);
+    list.addRounded(BATCH_ROUNDED, rect,
+                    widget.property<float>(ROUNDED_CORNER_RADIUS), 0.0f,
+                    RenderList::packColor(widget.getColor()));
   }
 
 
   // 画像描画
-  void image(const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  void image(RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
   {
-    setShader(texture_shader_);
-
-    // FIXME:仮描画
-    ci::gl::color(widget.getColor());
-    ci::gl::ScopedTextureBind texture(widget.at<ci::gl::Texture2dRef>("image"));
-    ci::gl::drawSolidRect(rect, ci::vec2(0, 0), ci::vec2(1, 1));
+    list.add(BATCH_TEXTURE, widget.property<TextureRef>(IMAGE_TEXTURE), rect, widget.property<ci::Rectf>(IMAGE_UV),
+             RenderList::packColor(widget.getColor()));
   }
 
 
-  static ci::vec2 calcTextPos(const ci::Rectf& rect, const ci::Rectf& bounds,
-                              const std::string& align_v, const std::string& align_h) noexcept
-  {
-    static std::map<std::string, std::function<float (const ci::Rectf& rect, const ci::Rectf& bounds)>> calc_v {
-      { "top",
-          [](const ci::Rectf& rect, const ci::Rectf& bounds) noexcept {
-          return rect.y2 - bounds.y2;
-        }
-      },
-      { "center",
-          [](const ci::Rectf& rect, const ci::Rectf& bounds) noexcept {
-          return ((rect.y2 - rect.y1) - bounds.y2) / 2.0f + rect.y1;
-        }
-      },
-      { "bottom",
-          [](const ci::Rectf& rect, const ci::Rectf& bounds) noexcept {
-          return rect.y1;
-        }
-      },
-    };
-    
-    static std::map<std::string, std::function<float (const ci::Rectf& rect, const ci::Rectf& bounds)>> calc_h {
-      { "left",
-          [](const ci::Rectf& rect, const ci::Rectf& bounds) noexcept {
-          return rect.x1;
-        }
-      },
-      { "center",
-          [](const ci::Rectf& rect, const ci::Rectf& bounds) noexcept {
-          return ((rect.x2 - rect.x1) - bounds.x2) / 2.0f + rect.x1;
-        }
-      },
-      { "right",
-          [](const ci::Rectf& rect, const ci::Rectf& bounds) noexcept {
-          return rect.x2 - bounds.x2;
-        }
-      },
-    };
+  // 文字列の揃え
+  enum class AlignV { TOP, CENTER, BOTTOM };
+  enum class AlignH { LEFT, CENTER, RIGHT };
 
-    float x = calc_h.at(align_h)(rect, bounds);
-    float y = calc_v.at(align_v)(rect, bounds);
+  // TIPS:知らない指定は中央揃え
+  static AlignV alignV(const Atom& align) noexcept
+  {
+    static const Atom top("top");
+    static const Atom bottom("bottom");
 
-    return ci::vec2(x, y);
+    return (align == top)    ? AlignV::TOP
+         : (align == bottom) ? AlignV::BOTTOM
+                             : AlignV::CENTER;
   }
-  
-  // 文字列表示
-  void text(const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+
+  static AlignH alignH(const Atom& align) noexcept
+  {
+    static const Atom left("left");
+    static const Atom right("right");
+
+    return (align == left)  ? AlignH::LEFT
+         : (align == right) ? AlignH::RIGHT
+                            : AlignH::CENTER;
+  }
+
+  static ci::vec2 calcTextPos(const ci::Rectf& rect, const ci::Rectf& bounds,
+                              const AlignV align_v, const AlignH align_h) noexcept
   {
-    // FIXME:仮描画
-    setShader(font_shader_);
+    ci::vec2 pos;
+
+    switch (align_h)
+    {
+    case AlignH::LEFT:   pos.x = rect.x1; break;
+    case AlignH::CENTER: pos.x = ((rect.x2 - rect.x1) - bounds.x2) / 2.0f + rect.x1; break;
+    case AlignH::RIGHT:  pos.x = rect.x2 - bounds.x2; break;
+    }
+
+    switch (align_v)
+    {
+    case AlignV::TOP:    pos.y = rect.y2 - bounds.y2; break;
+    case AlignV::CENTER: pos.y = ((rect.y2 - rect.y1) - bounds.y2) / 2.0f + rect.y1; break;
+    case AlignV::BOTTOM: pos.y = rect.y1; break;
+    }
+
+    return pos;
+  }
+
 
-    fonsSetSize(font_(), widget.at<float>("size"));
-    const ci::ColorA& color(widget.getColor());
-    fonsSetColor(font_(), font_.color(color.r, color.g, color.b, color.a));
-    
-    int f = fonsGetFontByName(font_(), widget.at<std::string>("font").c_str());
+  // 文字列の頂点を作り直す
+  void buildText(TextCache& cache) noexcept
+  {
+    int f = fonsGetFontByName(font_(), cache.font.c_str());
     assert(f != FONS_INVALID);
     fonsSetFont(font_(), f);
+    fonsSetSize(font_(), cache.size);
 
-    const auto& text = widget.at<std::string>("text");
     float bounds[4];
-    fonsTextBounds(font_(), 0, 0, text.c_str(), nullptr, bounds);
-
-    const auto& align_v = widget.at<std::string>("align_v");
-    const auto& align_h = widget.at<std::string>("align_h");
-    
-    auto pos = calcTextPos(rect, ci::Rectf(bounds[0], bounds[1], bounds[2], bounds[3]),
-                           align_v, align_h);
+    fonsTextBounds(font_(), 0, 0, cache.text.c_str(), nullptr, bounds);
+    auto pos = calcTextPos(cache.rect, ci::Rectf(bounds[0], bounds[1], bounds[2], bounds[3]),
+                           alignV(cache.align_v), alignH(cache.align_h));
+
+    cache.vertices.clear();
+
+    // TIPS:fonsDrawTextと同じ並びで三角形二つ
+    auto color = cache.color;
+    FONStextIter iter;
+    fonsTextIterInit(font_(), &iter, pos.x, pos.y, cache.text.c_str(), nullptr);
+    while (true)
+    {
+      FONSquad q = {};
+      if (!fonsTextIterNext(font_(), &iter, &q)) break;
+
+      cache.vertices.insert(std::end(cache.vertices), {
+          { ci::vec2(q.x0, q.y0), ci::vec2(q.s0, q.t0), color },
+          { ci::vec2(q.x1, q.y1), ci::vec2(q.s1, q.t1), color },
+          { ci::vec2(q.x1, q.y0), ci::vec2(q.s1, q.t0), color },
+          { ci::vec2(q.x0, q.y0), ci::vec2(q.s0, q.t0), color },
+          { ci::vec2(q.x0, q.y1), ci::vec2(q.s0, q.t1), color },
+          { ci::vec2(q.x1, q.y1), ci::vec2(q.s1, q.t1), color } });
+    }
+  }
 
-    fonsDrawText(font_(), pos.x, pos.y, text.c_str(), nullptr);
+  // 文字列表示
+  //   TIPS:内容や矩形が変わった時だけ頂点を作り直す
+  void text(RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  {
+    const auto& handle = widget.getHandle();
+    if (handle.index >= text_cache_.size()) text_cache_.resize(handle.index + 1);
+    auto& cache = text_cache_[handle.index];
+
+    const auto& font    = widget.property<std::string>(TEXT_FONT);
+    float size          = widget.property<float>(TEXT_SIZE);
+    const auto& text    = widget.property<std::string>(TEXT_TEXT);
+    const auto& align_v = widget.property<Atom>(TEXT_ALIGN_V);
+    const auto& align_h = widget.property<Atom>(TEXT_ALIGN_H);
+
+    auto color = RenderList::packColor(widget.getColor());
+
+    if ((cache.generation != handle.generation)
+        || (cache.atlas != font_.getGeneration())
+        || (cache.rect.x1 != rect.x1) || (cache.rect.y1 != rect.y1)
+        || (cache.rect.x2 != rect.x2) || (cache.rect.y2 != rect.y2)
+        || (cache.size != size)
+        || (cache.align_v != align_v) || (cache.align_h != align_h)
+        || (cache.text != text) || (cache.font != font))
+    {
+      cache.generation = handle.generation;
+      cache.atlas   = font_.getGeneration();
+      cache.rect    = rect;
+      cache.size    = size;
+      cache.align_v = align_v;
+      cache.align_h = align_h;
+      cache.text    = text;
+      cache.font    = font;
+      cache.color   = color;
+
+      buildText(cache);
+
+      // TIPS:テクスチャが作り直されたので、記録済みの文字列は使えない
+      if (cache.atlas != font_.getGeneration()) list.requestRecord();
+    }
+    else if (cache.color != color)
+    {
+      cache.color = color;
+      for (auto& v : cache.vertices)
+      {
+        v.color = color;
+      }
+    }
+
+    list.addVertices(BATCH_FONT, font_.getTexture(), cache.vertices.data(), u_int(cache.vertices.size()));
   }
   
 
+  // 頂点を全部転送する
+  //   all: falseならバッファを作り直した時だけ転送
+  //   TIPS:転送したらtrue
+  bool upload(VertexBuffer& buffer, const std::vector<RenderList::Vertex>& vertices, const bool all) noexcept
+  {
+    size_t bytes = vertices.size() * sizeof(RenderList::Vertex);
+    if (!buffer.vbo || (size_t(buffer.vbo->getSize()) < bytes))
+    {
+      createVertexBuffer(buffer, std::max(bytes, size_t(64 * 1024)));
+    }
+    else if (all)
+    {
+      // TIPS:バッファを捨てて(orphaning)から転送
+      buffer.vbo->bufferData(buffer.vbo->getSize(), nullptr, GL_DYNAMIC_DRAW);
+    }
+    else
+    {
+      return false;
+    }
+
+    buffer.vbo->bufferSubData(0, bytes, vertices.data());
+    return true;
+  }
+
+  // 記録した命令を順に描画
+  void submit(const RenderList& list, const VertexBuffer& buffer) noexcept
+  {
+    for (const auto& run : list.getRuns())
+    {
+      const auto& command = list.getCommand(run.command);
+      if (command.callback)
+      {
+        command.callback(command.context, *command.widget, command.rect, command.scale);
+        continue;
+      }
+
+      if (command.layer)
+      {
+        drawLayer(command, run, buffer);
+        continue;
+      }
+
+      assert(command.shader < BATCH_SHADER_NUM);
+      setShader(batchShader(command.shader));
+      ci::gl::ScopedVao vao(buffer.vao[command.shader]);
+      ci::gl::context()->setDefaultShaderVars();
+
+      if (command.shader == BATCH_ROUNDED)
+      {
+        // 続いている角丸矩形は一回で描く
+        setRoundedInstance(buffer, run.first);
+        ci::gl::drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, run.count / 2);
+      }
+      else if (command.texture)
+      {
+        ci::gl::ScopedTextureBind texture(command.texture);
+        ci::gl::drawArrays(GL_TRIANGLES, run.first, run.count);
+      }
+      else
+      {
+        ci::gl::drawArrays(GL_TRIANGLES, run.first, run.count);
+      }
+      batch_draw_num_ += 1;
+    }
+  }
+
+  // レイヤーをFBOに描く
+  //   TIPS:乗算済みアルファで描いておき、貼る時もそのまま合成する
+  void renderLayer(const RenderList& list, const ci::Rectf& rect, const ci::gl::FboRef& fbo) noexcept
+  {
+    upload(layer_buffer_, list.getVertices(), true);
+
+    ci::gl::ScopedFramebuffer framebuffer(fbo);
+    ci::gl::ScopedViewport viewport(ci::ivec2(0), fbo->getSize());
+    ci::gl::ScopedMatrices matrices;
+
+    // TIPS:貼る時は左上がuv(0, 0)なので、上端をFBOの下端(GLの原点)に合わせる
+    ci::CameraOrtho camera;
+    camera.setOrtho(rect.x1, rect.x2, rect.y1, rect.y2, -1.0f, 100.0f);
+    ci::gl::setMatrices(camera);
+
+    ci::gl::clear(ci::ColorA(0, 0, 0, 0));
+    ci::gl::ScopedBlend blend(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    submit(list, layer_buffer_);
+  }
+
+  // レイヤーを貼る
+  //   版が変わっていたら先に描き直す
+  void drawLayer(const RenderList::Command& command, const RenderList::Run& run, const VertexBuffer& buffer) noexcept
+  {
+    ci::ivec2 size(command.rect.getWidth(), command.rect.getHeight());
+    if ((size.x <= 0) || (size.y <= 0)) return;
+
+    const auto& layer = *command.layer;
+    bool render = false;
+    auto fbo = layer_cache_.acquire(layer.getId(), layer.getVersion(), size, render);
+    if (render) renderLayer(layer, command.rect, fbo);
+
+    setShader(texture_shader_);
+    ci::gl::ScopedVao vao(buffer.vao[BATCH_TEXTURE]);
+    ci::gl::ScopedBlendPremult blend;
+    ci::gl::context()->setDefaultShaderVars();
+    ci::gl::ScopedTextureBind texture(fbo->getColorTexture());
+    ci::gl::drawArrays(GL_TRIANGLES, run.first, run.count);
+    batch_draw_num_ += 1;
+  }
+
+
 public:
   Drawer() noexcept
   {
+    // TIPS:DrawTypeの順番で登録する
+    draw_funcs_.add("blank",             &Drawer::call<&Drawer::blank>,           this);
+    draw_funcs_.add("rect",              &Drawer::call<&Drawer::rect>,            this);
+    draw_funcs_.add("fill_rect",         &Drawer::call<&Drawer::fillRect>,        this);
+    draw_funcs_.add("rounded_rect",      &Drawer::call<&Drawer::roundedRect>,     this);
+    draw_funcs_.add("rounded_fill_rect", &Drawer::call<&Drawer::roundedFillRect>, this);
+    draw_funcs_.add("image",             &Drawer::call<&Drawer::image>,           this);
+    draw_funcs_.add("text",              &Drawer::call<&Drawer::text>,            this);
+    assert(draw_funcs_.size() == DRAW_TYPE_NUM);
+
     fonsClearState(font_());
     fonsSetAlign(font_(), FONS_ALIGN_LEFT | FONS_ALIGN_BOTTOM);
+
+    // TIPS:OpenGL ES 2.0にはPBOが無い
+#if !defined (CINDER_GL_ES_2)
+    font_.enablePixelBuffer(true);
+#endif
+
+    // TIPS:画像より先に詰めて、先頭のページに置く
+    atlas_.white();
   }
 
 
-  DrawFunc getFunc(const std::string& identifier) noexcept
+  // 描画関数
+  //   TIPS:読み込み時に一度だけ呼ぶ
+  const DrawFunc& getFunc(const Atom& identifier) const noexcept
   {
-    // TIPS:文字列から描画関数を指定用
-    std::map<std::string, DrawFunc> draw_func {
-      { "blank",             std::bind(&Drawer::blank,           this, std::placeholders::_1,  std::placeholders::_2, std::placeholders::_3) },
-      { "rect",              std::bind(&Drawer::rect,            this, std::placeholders::_1,  std::placeholders::_2, std::placeholders::_3) },
-      { "fill_rect",         std::bind(&Drawer::fillRect,        this, std::placeholders::_1,  std::placeholders::_2, std::placeholders::_3) },
-      { "rounded_rect",      std::bind(&Drawer::roundedRect,     this, std::placeholders::_1,  std::placeholders::_2, std::placeholders::_3) },
-      { "rounded_fill_rect", std::bind(&Drawer::roundedFillRect, this, std::placeholders::_1,  std::placeholders::_2, std::placeholders::_3) },
-      { "image",             std::bind(&Drawer::image,           this, std::placeholders::_1,  std::placeholders::_2, std::placeholders::_3) },
-      { "text",              std::bind(&Drawer::text,            this, std::placeholders::_1,  std::placeholders::_2, std::placeholders::_3) },
+    return draw_funcs_.get(identifier);
+  }
+
+  // 独自の描画関数を登録
+  //   起動時に行うこと
+  u_int addFunc(const Atom& identifier, const DrawFunc::Func func, void* context) noexcept
+  {
+    return draw_funcs_.add(identifier, func, context);
+  }
+
+
+  // 記録した内容を描画する
+  //   変わった頂点だけ転送する
+  //   TIPS:Canvasの描画が終わったら呼ぶこと
+  //        描画するUI::RenderListは一つだけの前提
+  void draw(RenderList& list) noexcept
+  {
+    layer_cache_.nextFrame();
+    font_.resetUploadStats();
+    batch_draw_num_ = 0;
+    if (list.empty()) return;
+
+    // 新しく使った文字をテクスチャへ
+    font_.updateTexture();
+
+    const auto& vertices = list.getVertices();
+    if (!upload(batch_buffer_, vertices, list.isUploadAll())
+        && (list.getUploadBegin() != list.getUploadEnd()))
+    {
+      u_int begin = list.getUploadBegin();
+      u_int end   = list.getUploadEnd();
+      batch_buffer_.vbo->bufferSubData(begin * sizeof(RenderList::Vertex), (end - begin) * sizeof(RenderList::Vertex),
+                                       &vertices[begin]);
+    }
+    list.clearUpload();
+
+    submit(list, batch_buffer_);
+  }
+
+  LayerCache& getLayerCache() noexcept
+  {
+    return layer_cache_;
+  }
+
+  // 最後に描画したフレームで文字をテクスチャへ転送した量(バイト)と回数
+  size_t getGlyphUploadBytes() const noexcept
+  {
+    return font_.getUploadBytes();
+  }
+
+  u_int getGlyphUploadNum() const noexcept
+  {
+    return font_.getUploadNum();
+  }
+
+  // 直前のフレームで頂点をまとめて描画した回数
+  u_int getBatchDrawNum() const noexcept
+  {
+    return batch_draw_num_;
+  }
+
+
+  // 描画関数ごとに必要な値とその型
+  PropertySchema getSchema(const Atom& identifier) const noexcept
+  {
+    static const std::unordered_map<Atom, PropertySchema> schema {
+      { "rect",              { propertySpec<float>("line_width") } },
+      { "rounded_rect",      { propertySpec<float>("corner_radius"),
+                               propertySpec<float>("line_width", 1.0f) } },
+      { "rounded_fill_rect", { propertySpec<float>("corner_radius") } },
+      { "image",             { propertySpec<TextureRef>("image"),
+                               propertySpec<ci::Rectf>("uv") } },
+      { "text",              { propertySpec<std::string>("font"),
+                               propertySpec<float>("size"),
+                               propertySpec<std::string>("text"),
+                               propertySpec<Atom>("align_v"),
+                               propertySpec<Atom>("align_h") } },
     };
 
-    assert(draw_func.count(identifier));
-    return draw_func.at(identifier);
+    auto it = schema.find(identifier);
+    if (it == std::end(schema)) return PropertySchema();
+
+    return it->second;
   }
 
 
@@ -205,6 +608,18 @@ public:
     font_.add(path, path);
   }
 
+  // 画像読み込み
+  //   TIPS:小さな画像はまとめたテクスチャに入る
+  AtlasImage loadImage(const std::string& path) noexcept
+  {
+    return atlas_.load(path);
+  }
+
+  const TextureAtlas& getAtlas() const noexcept
+  {
+    return atlas_;
+  }
+
 };
 
 } }
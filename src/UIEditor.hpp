@@ -25,10 +25,10 @@ class Editor
 
   // Widgetを列挙
   static void createWidgetList(std::vector<std::string>& list, std::vector<std::string>& id_list,
-                               const WidgetPtr& parent_widget, int depth) noexcept
+                               Widget* parent_widget, int depth) noexcept
   {
     std::string id(depth, '-');
-    const auto& id_widget = parent_widget->getIdentifier();
+    const auto& id_widget = parent_widget->getIdentifier().str();
     id_list.push_back(id_widget);
     list.push_back(id + id_widget);
 
@@ -40,7 +40,7 @@ class Editor
     }
   }
 
-  ci::params::InterfaceGlRef createWidgetList(const WidgetPtr& root_widget) noexcept
+  ci::params::InterfaceGlRef createWidgetList(Widget* root_widget) noexcept
   {
     std::vector<std::string> id_list;
     createWidgetList(id_list, id_list_, root_widget, 0);
@@ -68,7 +68,8 @@ class Editor
     setting->addParam("path", &widget->at<std::string>("path")).updateFn([widget]() {
         // TODO:エラー対策
         auto image = ci::gl::Texture2d::create(ci::loadImage(Asset::load(widget->at<std::string>("path"))));
-              (*widget)["image"] = image;
+        widget->setProperty("image", TextureRef(image));
+        widget->setProperty("uv", ci::Rectf(0, 0, 1, 1));
       });
   }
 
@@ -90,11 +91,11 @@ class Editor
       setting->addParam("align_v", align_v_list,
                         [widget](int index) {
                           // Setter
-                          widget->at<std::string>("align_v") = align_v_list[index];
+                          widget->at<Atom>("align_v") = Atom(align_v_list[index]);
                         },
                         [widget]() {
                           // Getter
-                          const auto& align_v = widget->at<std::string>("align_v");
+                          const auto& align_v = widget->at<Atom>("align_v").str();
 
                           // 配列から値を探してそのindexを返却している
                           auto it = std::find(std::begin(align_v_list), std::end(align_v_list), align_v);
@@ -110,11 +111,11 @@ class Editor
       setting->addParam("align_h", align_h_list,
                         [widget](int index) {
                           // Setter
-                          widget->at<std::string>("align_h") = align_h_list[index];
+                          widget->at<Atom>("align_h") = Atom(align_h_list[index]);
                         },
                         [widget]() {
                           // Getter
-                          const auto& align_h = widget->at<std::string>("align_h");
+                          const auto& align_h = widget->at<Atom>("align_h").str();
                           
                           auto it = std::find(std::begin(align_h_list), std::end(align_h_list), align_h);
                           size_t index = std::distance(std::begin(align_h_list), it);
@@ -131,7 +132,7 @@ class Editor
   {
     setting->addSeparator();
     
-    static std::map<std::string, std::function<void(const ci::params::InterfaceGlRef& setting, Widget* widget)>> func_tbl = {
+    static std::unordered_map<Atom, std::function<void(const ci::params::InterfaceGlRef& setting, Widget* widget)>> func_tbl = {
       { "blank",
         [](const ci::params::InterfaceGlRef& setting, Widget* widget) {} },
 
@@ -142,9 +143,14 @@ class Editor
       { "fill_rect",
         [](const ci::params::InterfaceGlRef& setting, Widget* widget) {} },
       { "rounded_rect",
-        [](const ci::params::InterfaceGlRef& setting, Widget* widget) {} },
+        [](const ci::params::InterfaceGlRef& setting, Widget* widget) {
+          setting->addParam("corner radius", &widget->at<float>("corner_radius"));
+          setting->addParam("line width", &widget->at<float>("line_width"));
+        } },
       { "rounded_fill_rect",
-        [](const ci::params::InterfaceGlRef& setting, Widget* widget) {} },
+        [](const ci::params::InterfaceGlRef& setting, Widget* widget) {
+          setting->addParam("corner radius", &widget->at<float>("corner_radius"));
+        } },
 
       { "image",
         std::bind(&Editor::widgetImage, this, std::placeholders::_1, std::placeholders::_2) },
@@ -161,8 +167,14 @@ class Editor
     setting->clear();
 
     // 全UI共通のパラメーター
-    setting->addParam("Identifier", &widget->getIdentifier());
-    setting->addParam("Type", &widget->getType());
+    setting->addParam<std::string>("Identifier",
+                                   [widget](std::string identifier) {
+                                     widget->setIdentifier(identifier);
+                                   },
+                                   [widget]() {
+                                     return widget->getIdentifier().str();
+                                   });
+    setting->addText("Type: " + widget->getType().str());
 
     setting->addSeparator();
     
@@ -193,6 +205,8 @@ class Editor
     setting->addParam("active", &widget->getActive());
     setting->addParam("display", &widget->getDisplay());
     setting->addParam("touch_event", &widget->getTouchEvent());
+    setting->addParam("clip_children", &widget->getClipChildren());
+    setting->addParam("cache_as_layer", &widget->getCacheAsLayer());
 
     // 個別設定
     createWidgetSeparateSetting(setting, widget);
@@ -204,7 +218,7 @@ public:
     : canvas_(canvas),
       drawer_(drawer)
   {
-    list_ = createWidgetList(canvas.rootWidgetPtr());
+    list_ = createWidgetList(canvas.rootWidget());
     createWidgetSetting(setting_, canvas.rootWidget());
   }
 
@@ -0,0 +1,765 @@
+﻿//
+// UIテスト(ヘッドレス版)
+//   ウインドウもOpenGLも使わずにUIの処理を動かして時間を計測する
+//   UIHeadless [layout|parallel|touch|draw|dispatch|batch|popup|query|event|scene] [Widgetの数] [--strict]
+//   種類を省略すると全部実行
+//   --strictを付けると、並列計算の伸びが基準に届かない時に1で終了
+//   TIPS:計測のぶれで落ちるので、CI(ctest)では判定しない
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <limits>
+#include <boost/signals2.hpp>
+#include <cinder/Timeline.h>
+
+#include "Defines.hpp"
+#include "Params.hpp"
+#include "JsonUtil.hpp"
+#include "Touch.hpp"
+#include "ThreadPool.hpp"
+#include "UICanvas.hpp"
+#include "UINullDrawer.hpp"
+#include "UIWidgetsFactory.hpp"
+#include "UIWidgetRef.hpp"
+#include "UIRenderList.hpp"
+#include "Scene.hpp"
+
+
+// 確保したメモリの量
+//   TIPS:置き換えたnew/deleteは全部ここを通す(解放は全部operator delete(void*)に集める)
+std::atomic<size_t> allocated_bytes(0);
+
+// TIPS:new/deleteがインライン展開されると、確保と解放の関数が食い違っているとGCCが警告する
+#if defined(__GNUC__)
+#define NGS_NOINLINE __attribute__((noinline))
+#else
+#define NGS_NOINLINE
+#endif
+
+NGS_NOINLINE void* operator new(std::size_t size)
+{
+  allocated_bytes += size;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+NGS_NOINLINE void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+NGS_NOINLINE void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  allocated_bytes += size;
+  return std::malloc(size ? size : 1);
+}
+
+NGS_NOINLINE void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+  return operator new(size, tag);
+}
+
+NGS_NOINLINE void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+NGS_NOINLINE void operator delete[](void* p) noexcept
+{
+  operator delete(p);
+}
+
+NGS_NOINLINE void operator delete(void* p, std::size_t) noexcept
+{
+  operator delete(p);
+}
+
+NGS_NOINLINE void operator delete[](void* p, std::size_t) noexcept
+{
+  operator delete(p);
+}
+
+NGS_NOINLINE void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  operator delete(p);
+}
+
+NGS_NOINLINE void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  operator delete(p);
+}
+
+#if defined(__cpp_aligned_new)
+
+// アラインメント指定付き
+//   TIPS:aligned_allocはサイズがアラインメントの倍数でないといけない
+//        C++17未満(__cpp_aligned_newが無い)では置き換えないので数えない
+NGS_NOINLINE void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+  allocated_bytes += size;
+  auto alignment = std::max(std::size_t(align), sizeof(void*));
+  return std::aligned_alloc(alignment, (std::max(size, std::size_t(1)) + alignment - 1) / alignment * alignment);
+}
+
+NGS_NOINLINE void* operator new(std::size_t size, std::align_val_t align)
+{
+  if (void* p = operator new(size, align, std::nothrow)) return p;
+  throw std::bad_alloc();
+}
+
+NGS_NOINLINE void* operator new[](std::size_t size, std::align_val_t align)
+{
+  return operator new(size, align);
+}
+
+NGS_NOINLINE void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t& tag) noexcept
+{
+  return operator new(size, align, tag);
+}
+
+NGS_NOINLINE void operator delete(void* p, std::align_val_t) noexcept
+{
+  operator delete(p);
+}
+
+NGS_NOINLINE void operator delete[](void* p, std::align_val_t) noexcept
+{
+  operator delete(p);
+}
+
+NGS_NOINLINE void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+  operator delete(p);
+}
+
+NGS_NOINLINE void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+  operator delete(p);
+}
+
+NGS_NOINLINE void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  operator delete(p);
+}
+
+NGS_NOINLINE void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  operator delete(p);
+}
+
+#endif
+
+
+namespace ngs {
+
+// 計測用の画面サイズ
+const ci::vec2 canvas_size(1024, 768);
+
+// 並列計算の基準(--strictの時だけ判定)
+//   一人で作業した時の遅れは逐次計算の何倍までか
+const double parallel_overhead_limit = 1.5;
+//   スレッドを増やした時の遅れは一人の時の何倍までか
+const double parallel_slowdown_limit = 1.25;
+//   4スレッド以上使える時、逐次計算より何倍速くなるか
+const double parallel_speedup_limit = 1.5;
+
+
+// count回実行した時の一回あたりの時間(μs)
+template<typename F>
+double measure(const u_int count, F func) noexcept
+{
+  auto begin = std::chrono::steady_clock::now();
+  for (u_int i = 0; i < count; ++i)
+  {
+    func(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::micro>(end - begin).count() / count;
+}
+
+// rounds回計測して一番速かったもの
+//   TIPS:他の処理に邪魔された回を除く
+template<typename F>
+double measureBest(const u_int rounds, const u_int count, F func) noexcept
+{
+  double best = std::numeric_limits<double>::max();
+  for (u_int i = 0; i < rounds; ++i)
+  {
+    best = std::min(best, measure(count, func));
+  }
+  return best;
+}
+
+void report(const std::string& name, const double usec) noexcept
+{
+  std::cout << std::left << std::setw(32) << name
+            << std::right << std::fixed << std::setprecision(2) << std::setw(12) << usec << " us"
+            << std::endl;
+}
+
+
+// 計測用にWidgetを大量に生成
+//   i番目の親は(i - 1) / fanout番目
+UI::Widget* createWidgets(UI::NullDrawer& drawer, UI::WidgetArena& arena,
+                          const u_int num, const u_int fanout) noexcept
+{
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+  auto widgets = std::make_shared<UI::WidgetQuery>();
+  std::vector<UI::Widget*> all;
+  all.reserve(num);
+
+  for (u_int i = 0; i < num; ++i)
+  {
+    ci::Rectf rect(-10.0f, -10.0f, 10.0f, 10.0f);
+    auto* widget = arena.create("widget" + std::to_string(i), rect,
+                                widgets, drawer.getFunc("fill_rect"));
+
+    widget->setAnchor(ci::vec2(dist(random), dist(random)), ci::vec2(dist(random), dist(random)));
+    widget->setPivot(ci::vec2(dist(random), dist(random)));
+    widget->enableTouchEvent(true);
+
+    if (i > 0)
+    {
+      all[(i - 1) / fanout]->addChild(widget);
+    }
+    all.push_back(widget);
+  }
+
+  return all[0];
+}
+
+
+// 位置・サイズ計算
+void benchLayout(const u_int num) noexcept
+{
+  UI::NullDrawer drawer;
+  UI::Canvas canvas(canvas_size);
+  canvas.setWidgets(createWidgets(drawer, canvas.getArena(), num, 8));
+  canvas.updateLayout();
+
+  auto* root = canvas.rootWidget();
+  auto* leaf = canvas.findWidget("widget" + std::to_string(num - 1));
+
+  report("layout: unchanged", measure(1000, [&canvas](u_int) {
+        canvas.updateLayout();
+      }));
+
+  report("layout: leaf rect", measure(1000, [&canvas, leaf](u_int i) {
+        leaf->setRect(ci::Rectf(-10.0f, -10.0f, 10.0f + (i & 1), 10.0f));
+        canvas.updateLayout();
+      }));
+
+  report("layout: root scale", measure(1000, [&canvas, root](u_int i) {
+        root->setScale(ci::vec2(1.0f + (i & 1) * 0.5f));
+        canvas.updateLayout();
+      }));
+
+  report("layout: resize", measure(1000, [&canvas](u_int i) {
+        canvas.resize(canvas_size + ci::vec2(i & 1));
+        canvas.updateLayout();
+      }));
+}
+
+// 並列計算でスレッド数を変えた時の計測
+//   逐次計算に対する速さの伸びを表示する
+//   strictなら基準も判定して、届かなければfalse
+bool benchParallel(const u_int num, const bool strict) noexcept
+{
+  UI::NullDrawer drawer;
+  UI::Canvas canvas(canvas_size);
+  canvas.setWidgets(createWidgets(drawer, canvas.getArena(), num, 8));
+  auto* root = canvas.rootWidget();
+
+  auto scale = [&canvas, root](u_int i) {
+    root->setScale(ci::vec2(1.0f + (i & 1) * 0.5f));
+    canvas.updateLayout();
+  };
+
+  canvas.updateLayout();
+  double serial = measureBest(10, 100, scale);
+  report("parallel: root scale serial", serial);
+
+  bool result = true;
+  double single = serial;
+  double best   = serial;
+  u_int max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  if (max_threads == 1) std::cout << "  hardware threads: 1 (no scaling to measure)" << std::endl;
+  for (u_int threads = 1; threads <= max_threads; ++threads)
+  {
+    // TIPS:呼び出し側のスレッドも作業するので一つ少なく作る
+    canvas.enableParallelLayout(std::make_shared<ThreadPool>(threads - 1), 0);
+    canvas.updateLayout();
+
+    double usec = measureBest(10, 100, scale);
+    report("parallel: root scale x" + std::to_string(threads), usec);
+    std::cout << "  speedup: " << std::setprecision(2) << serial / usec
+              << " efficiency: " << serial / usec / threads << std::endl;
+
+    if (threads == 1)
+    {
+      single = usec;
+      if (usec > serial * parallel_overhead_limit)
+      {
+        if (strict) std::cout << "  FAILED: overhead over x" << parallel_overhead_limit << std::endl;
+        result = false;
+      }
+    }
+    else if (usec > single * parallel_slowdown_limit)
+    {
+      if (strict) std::cout << "  FAILED: slower than x1 by over x" << parallel_slowdown_limit << std::endl;
+      result = false;
+    }
+    best = std::min(best, usec);
+  }
+  canvas.enableParallelLayout(nullptr);
+
+  if ((max_threads >= 4) && (serial / best < parallel_speedup_limit))
+  {
+    if (strict) std::cout << "  FAILED: best speedup under x" << parallel_speedup_limit << std::endl;
+    result = false;
+  }
+
+#if !defined(NDEBUG)
+  // TIPS:最適化無しでは判定しない
+  result = true;
+#endif
+  return result || !strict;
+}
+
+// タッチ判定
+void benchTouch(const u_int num) noexcept
+{
+  UI::NullDrawer drawer;
+  UI::Canvas canvas(canvas_size);
+  canvas.setWidgets(createWidgets(drawer, canvas.getArena(), num, 8));
+  canvas.updateLayout();
+
+  u_int event_num = 0;
+  const auto& layout = canvas.getLayout();
+  for (u_int i = 0; i < layout.size(); ++i)
+  {
+    layout.widget(i)->connect([&event_num](const DelegateConnection&, UI::Widget&, const UI::Widget::TouchEvent, const Touch&) {
+        event_num += 1;
+      });
+  }
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> dist_x(-canvas_size.x / 2.0f, canvas_size.x / 2.0f);
+  std::uniform_real_distribution<float> dist_y(-canvas_size.y / 2.0f, canvas_size.y / 2.0f);
+
+  report("touch: began", measure(1000, [&](u_int i) {
+        ci::vec2 pos(dist_x(random), dist_y(random));
+
+        canvas.touchBegan(Touch(i, pos, pos, true));
+        canvas.touchEnded(Touch(i, pos, pos, true));
+      }));
+
+  // TIPS:タッチ可能かどうかが変わったWidgetだけ空間分割に登録し直す
+  auto* leaf = canvas.findWidget("widget" + std::to_string(num - 1));
+  report("touch: began after flag change", measure(1000, [&](u_int i) {
+        ci::vec2 pos(dist_x(random), dist_y(random));
+
+        leaf->enableTouchEvent(i & 1);
+        canvas.touchBegan(Touch(i, pos, pos, true));
+        canvas.touchEnded(Touch(i, pos, pos, true));
+      }));
+  leaf->enableTouchEvent(true);
+
+  report("touch: began-moved-ended", measure(1000, [&](u_int i) {
+        ci::vec2 pos(dist_x(random), dist_y(random));
+        ci::vec2 moved(dist_x(random), dist_y(random));
+
+        canvas.touchBegan(Touch(i, pos, pos, true));
+        canvas.touchMoved(Touch(i, moved, pos, true));
+        canvas.touchEnded(Touch(i, moved, moved, true));
+      }));
+
+  std::cout << "  events: " << event_num << std::endl;
+}
+
+// 描画(スクロールするパネル)
+//   行のほとんどが画面外
+void benchDraw(const u_int num) noexcept
+{
+  UI::NullDrawer drawer;
+  auto widgets = std::make_shared<UI::WidgetQuery>();
+
+  UI::Canvas canvas(canvas_size);
+  auto& arena = canvas.getArena();
+
+  auto* root = arena.create("root", ci::Rectf(0, 0, 0, 0), widgets, drawer.getFunc("blank"));
+  root->setAnchor(ci::vec2(0.0f), ci::vec2(1.0f));
+
+  auto* panel = arena.create("panel", ci::Rectf(-200, -300, 200, 300), widgets, drawer.getFunc("rect"));
+  panel->enableClipChildren(true);
+  root->addChild(panel);
+
+  auto* list = arena.create("list", ci::Rectf(0, 0, 0, 0), widgets, drawer.getFunc("blank"));
+  list->setAnchor(ci::vec2(0.0f, 1.0f), ci::vec2(1.0f, 1.0f));
+  panel->addChild(list);
+
+  for (u_int i = 0; i < num; ++i)
+  {
+    float y = -20.0f * (i + 1);
+    auto* row = arena.create("row" + std::to_string(i), ci::Rectf(0, y, 0, y + 18.0f),
+                             widgets, drawer.getFunc("fill_rect"));
+    row->setAnchor(ci::vec2(0.0f, 0.0f), ci::vec2(1.0f, 0.0f));
+    list->addChild(row);
+  }
+
+  canvas.setWidgets(root);
+
+  report("draw: scroll panel", measure(1000, [&canvas, list](u_int i) {
+        list->setRect(ci::Rectf(0, float(i), 0, float(i)));
+        canvas.draw();
+      }));
+
+  std::cout << "  drawn: " << canvas.getDrawnNum()
+            << " culled: " << canvas.getCulledNum() << std::endl;
+
+  // TIPS:変化が無ければ記録を使い回す
+  const auto& render_list = canvas.getRenderList();
+  report("draw: unchanged", measure(1000, [&canvas](u_int) {
+        canvas.draw();
+      }));
+  std::cout << "  recorded: " << render_list.getRecordedNum()
+            << " replayed: " << render_list.getReplayedNum() << std::endl;
+
+  // TIPS:色だけ変わったWidgetは記録を書き換える
+  list->setRect(ci::Rectf(0, 0, 0, 0));
+  auto* row = canvas.findWidget("row0");
+  report("draw: row color", measure(1000, [&canvas, row](u_int i) {
+        row->setColor(ci::ColorA(1.0f, float(i & 1), 1.0f, 1.0f));
+        canvas.draw();
+      }));
+  std::cout << "  recorded: " << render_list.getRecordedNum()
+            << " replayed: " << render_list.getReplayedNum() << std::endl;
+}
+
+// 描画関数の呼び出し
+//   以前のstd::function(std::bind)経由の呼び出しと比べる
+void benchDispatch(const u_int num) noexcept
+{
+  UI::NullDrawer drawer;
+  UI::Canvas canvas(canvas_size);
+  canvas.setWidgets(createWidgets(drawer, canvas.getArena(), num, 8));
+  canvas.updateLayout();
+
+  const auto& layout = canvas.getLayout();
+  ci::Rectf rect(0, 0, 10, 10);
+  ci::vec2 scale(1);
+
+  UI::RenderList list;
+  list.begin(layout.size());
+  report("dispatch: DrawFunc", measure(1000, [&](u_int) {
+        for (u_int i = 0; i < layout.size(); ++i)
+        {
+          list.beginWidget();
+          layout.widget(i)->draw(list, rect, scale);
+        }
+      }));
+
+  // TIPS:以前のUI::Drawer::getFuncと同じくメンバ関数をstd::bindしたもの
+  struct Counter
+  {
+    u_int draw_num = 0;
+
+    // TIPS:UI::NullDrawerと同じ記録を行う
+    void draw(UI::RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+    {
+      draw_num += 1;
+      list.addCallback(&Counter::replay, this, widget, rect, scale);
+    }
+
+    static void replay(void*, const UI::Widget&, const ci::Rectf&, const ci::vec2&) noexcept
+    {
+    }
+  };
+  Counter counter;
+
+  std::vector<std::function<void (UI::RenderList&, const UI::Widget&, const ci::Rectf&, const ci::vec2&)>> funcs;
+  for (u_int i = 0; i < layout.size(); ++i)
+  {
+    funcs.push_back(std::bind(&Counter::draw, &counter,
+                              std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+  }
+
+  report("dispatch: std::function", measure(1000, [&](u_int) {
+        for (u_int i = 0; i < layout.size(); ++i)
+        {
+          list.beginWidget();
+          funcs[i](list, *layout.widget(i), rect, scale);
+        }
+      }));
+
+  std::cout << "  draws: " << drawer.getDrawNum() << " / " << counter.draw_num
+            << " size: " << sizeof(UI::DrawFunc) << " / " << sizeof(funcs[0]) << std::endl;
+}
+
+// 四角形をまとめる
+//   8個に1個が画像(2種類のテクスチャを交互に使う)
+void benchBatch(const u_int num) noexcept
+{
+  UI::NullDrawer drawer;
+  UI::Canvas canvas(canvas_size);
+  canvas.setWidgets(createWidgets(drawer, canvas.getArena(), num, 8));
+  canvas.updateLayout();
+  const auto& layout = canvas.getLayout();
+
+  // TIPS:比較に使うだけなので中身の無いテクスチャ
+  int dummy[2];
+  UI::TextureRef textures[] = {
+    UI::TextureRef(std::shared_ptr<void>(), reinterpret_cast<ci::gl::Texture2d*>(&dummy[0])),
+    UI::TextureRef(std::shared_ptr<void>(), reinterpret_cast<ci::gl::Texture2d*>(&dummy[1])),
+  };
+
+  UI::RenderList list;
+  // white:塗り潰しをUI::Drawerと同じく白いテクセルで描く(画像と同じシェーダー、先頭のページ)
+  //       falseなら塗り潰し専用のシェーダー
+  auto fill = [&](const bool with_image, const bool white) {
+    list.begin(layout.size());
+    for (u_int i = 0; i < layout.size(); ++i)
+    {
+      auto color = UI::RenderList::packColor(layout.widget(i)->getColor());
+      list.beginWidget();
+      if (with_image && ((i % 8) == 7))
+      {
+        list.add(1, textures[(i / 8) & 1], layout.worldRect(i), ci::Rectf(0, 0, 1, 1), color);
+      }
+      else if (white)
+      {
+        list.add(1, textures[0], layout.worldRect(i), ci::Rectf(0.5f, 0.5f, 0.5f, 0.5f), color);
+      }
+      else
+      {
+        list.add(0, UI::TextureRef(), layout.worldRect(i), ci::Rectf(0, 0, 0, 0), color);
+      }
+      list.endWidget(i);
+    }
+    list.end();
+  };
+
+  report("batch: fill_rect", measure(100, [&](u_int) { fill(false, false); }));
+  std::cout << "  quads: " << list.getVertices().size() / 6 << " runs: " << list.getRuns().size() << std::endl;
+
+  report("batch: fill_rect + image", measure(100, [&](u_int) { fill(true, false); }));
+  size_t color_runs = list.getRuns().size();
+  std::cout << "  quads: " << list.getVertices().size() / 6 << " runs: " << color_runs << std::endl;
+
+  // TIPS:画像の半分は別のページにあるので、その前後だけ切れる
+  report("batch: white texel + image", measure(100, [&](u_int) { fill(true, true); }));
+  size_t white_runs = list.getRuns().size();
+  std::cout << "  quads: " << list.getVertices().size() / 6 << " runs: " << white_runs
+            << " (" << color_runs << " -> " << white_runs << ")" << std::endl;
+  assert(white_runs < color_runs);
+}
+
+// ポップアップの生成と破棄を繰り返す
+void benchPopup(const u_int) noexcept
+{
+  UI::NullDrawer drawer;
+  UI::Canvas canvas(canvas_size);
+  auto& arena = canvas.getArena();
+
+  auto widgets = std::make_shared<UI::WidgetQuery>();
+  auto* root = arena.create("root", ci::Rectf(0, 0, 0, 0), widgets, drawer.getFunc("blank"));
+  root->setAnchor(ci::vec2(0.0f), ci::vec2(1.0f));
+  canvas.setWidgets(root);
+
+  report("popup: create-destroy x64", measure(1000, [&](u_int) {
+        auto* popup = arena.create("popup", ci::Rectf(-200, -100, 200, 100), widgets, drawer.getFunc("fill_rect"));
+        for (u_int i = 0; i < 63; ++i)
+        {
+          float y = 90.0f - i * 3.0f;
+          popup->addChild(arena.create("item" + std::to_string(i), ci::Rectf(-180, y - 2.0f, 180, y),
+                                       widgets, drawer.getFunc("fill_rect")));
+        }
+        root->addChild(popup);
+        canvas.draw();
+
+        canvas.destroyWidget(popup);
+        canvas.draw();
+      }));
+
+  std::cout << "  alive: " << arena.size() << std::endl;
+}
+
+// Widgetの検索
+void benchQuery(const u_int num) noexcept
+{
+  UI::NullDrawer drawer;
+  UI::Canvas canvas(canvas_size);
+  canvas.setWidgets(createWidgets(drawer, canvas.getArena(), num, 8));
+
+  const std::string identifier = "widget" + std::to_string(num - 1);
+  report("query: findWidget", measure(1000, [&](u_int) {
+        canvas.findWidget(identifier);
+      }));
+
+  // 深さ優先で末尾のWidgetまでの経路
+  std::string path;
+  for (auto* widget = canvas.findWidget(identifier); widget; widget = widget->getParent())
+  {
+    path = widget->getIdentifier().str() + (path.empty() ? "" : "/") + path;
+  }
+  report("query: findWidgetPath", measure(1000, [&](u_int) {
+        canvas.findWidgetPath(path);
+      }));
+
+  UI::WidgetRef ref(canvas, identifier);
+  report("query: WidgetRef", measure(1000, [&](u_int) {
+        ref.get();
+      }));
+
+  // TIPS:木構造が変わると探し直す
+  auto* leaf = ref.get();
+  auto* parent = leaf->getParent();
+  report("query: WidgetRef after reparent", measure(1000, [&](u_int) {
+        parent->removeChild(leaf);
+        parent->addChild(leaf);
+        ref.get();
+      }));
+}
+
+// タッチイベントの通知
+//   以前のboost::signals2と比べる
+template<typename T, typename F>
+void benchEventType(const std::string& name, const u_int num, UI::Widget& widget, F connect) noexcept
+{
+  size_t allocated = allocated_bytes;
+  std::vector<std::unique_ptr<T>> events;
+  for (u_int i = 0; i < num; ++i)
+  {
+    events.emplace_back(new T);
+    connect(*events.back());
+  }
+  size_t bytes = allocated_bytes - allocated;
+
+  Touch touch(0, ci::vec2(0), ci::vec2(0), true);
+  report("event: emit " + name, measure(100000, [&](u_int i) {
+        (*events[i % num])(widget, UI::Widget::TouchEvent::BEGAN, touch);
+      }));
+
+  std::cout << "  bytes per widget: " << (bytes / num) << " (sizeof " << sizeof(T) << ")" << std::endl;
+}
+
+void benchEvent(const u_int num) noexcept
+{
+  UI::NullDrawer drawer;
+  UI::WidgetArena arena;
+  auto* widget = arena.create("widget", ci::Rectf(0, 0, 0, 0),
+                              std::make_shared<UI::WidgetQuery>(), drawer.getFunc("blank"));
+
+  u_int event_num = 0;
+  using Signal = boost::signals2::signal<void (UI::Widget&, const UI::Widget::TouchEvent, const Touch&)>;
+  benchEventType<Signal>("signals2", num, *widget, [&event_num](Signal& signal) {
+      signal.connect_extended([&event_num](const boost::signals2::connection&, UI::Widget&, const UI::Widget::TouchEvent, const Touch&) {
+          event_num += 1;
+        });
+    });
+
+  using Fast = Delegate<void (UI::Widget&, const UI::Widget::TouchEvent, const Touch&)>;
+  benchEventType<Fast>("Delegate", num, *widget, [&event_num](Fast& delegate) {
+      delegate.connect([&event_num](const DelegateConnection&, UI::Widget&, const UI::Widget::TouchEvent, const Touch&) {
+          event_num += 1;
+        });
+    });
+
+  using Safe = ThreadSafeDelegate<void (UI::Widget&, const UI::Widget::TouchEvent, const Touch&)>;
+  benchEventType<Safe>("ThreadSafeDelegate", num, *widget, [&event_num](Safe& delegate) {
+      delegate.connect([&event_num](const DelegateConnection&, UI::Widget&, const UI::Widget::TouchEvent, const Touch&) {
+          event_num += 1;
+        });
+    });
+
+  std::cout << "  events: " << event_num << std::endl;
+}
+
+// scene_test.jsonを読み込んでTweenと描画を動かす
+void benchScene() noexcept
+{
+  UI::NullDrawer drawer;
+  UI::WidgetsFactory<UI::NullDrawer> widgets_factory(drawer);
+  Scene scene(Params::load("scene_test.json"), widgets_factory, canvas_size);
+
+  auto timeline = ci::Timeline::create();
+  scene.getTweenSet().start("start", timeline, scene.getCanvas().rootWidget());
+
+  auto* button = scene.getCanvas().findWidget("button1");
+  button->connect([&scene, &timeline](const DelegateConnection&, UI::Widget& widget, const UI::Widget::TouchEvent touch_event, const Touch&) {
+      switch (touch_event)
+      {
+      case UI::Widget::TouchEvent::BEGAN:
+        scene.getTweenSet().start("began", timeline, &widget);
+        break;
+
+      case UI::Widget::TouchEvent::ENDED_IN:
+        scene.getTweenSet().start("ended", timeline, &widget);
+        break;
+
+      default:
+        break;
+      }
+    });
+
+  // 60fpsで進める
+  double time = 0.0;
+  report("scene: frame", measure(10000, [&](u_int i) {
+        if ((i % 60) == 0)
+        {
+          scene.getCanvas().updateLayout();
+          ci::vec2 pos = scene.getCanvas().getLayout().worldRect(button->getLayoutIndex()).getCenter();
+          Touch touch(0, pos, pos, true);
+          scene.getCanvas().touchBegan(touch);
+          scene.getCanvas().touchEnded(touch);
+        }
+
+        time += 1.0 / 60.0;
+        timeline->stepTo(time);
+        scene.getCanvas().draw();
+      }));
+
+  const auto& render_list = scene.getCanvas().getRenderList();
+  std::cout << "  draws: " << drawer.getDrawNum()
+            << " recorded: " << render_list.getRecordedNum()
+            << " replayed: " << render_list.getReplayedNum() << std::endl;
+
+  // TIPS:ボタンの連打
+  auto tween_timeline = ci::Timeline::create();
+  report("scene: tween start", measure(1000, [&](u_int) {
+        scene.getTweenSet().start("began", tween_timeline, button);
+      }));
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+  std::string mode = (argc > 1) ? argv[1] : "all";
+  ngs::u_int num   = (argc > 2) ? std::stoi(argv[2]) : 10000;
+  bool strict      = (argc > 3) && (std::string(argv[3]) == "--strict");
+
+  if (mode == "all" || mode == "layout")   ngs::benchLayout(num);
+  bool result = true;
+  if (mode == "all" || mode == "parallel") result = ngs::benchParallel(num, strict) && result;
+  if (mode == "all" || mode == "touch")    ngs::benchTouch(num);
+  if (mode == "all" || mode == "draw")     ngs::benchDraw(num);
+  if (mode == "all" || mode == "dispatch") ngs::benchDispatch(num);
+  if (mode == "all" || mode == "batch")    ngs::benchBatch(num);
+  if (mode == "all" || mode == "popup")    ngs::benchPopup(num);
+  if (mode == "all" || mode == "query")    ngs::benchQuery(num);
+  if (mode == "all" || mode == "event")    ngs::benchEvent(num);
+  if (mode == "all" || mode == "scene")    ngs::benchScene();
+
+  return result ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+﻿#pragma once
+
+//
+// レイヤー(部分木を描いたテクスチャ)の置き場所
+//   UI::RenderListの識別番号ごとにFBOを持ち、版が変わった時だけ描き直す
+//   使えるメモリの量を決めておき、溢れたら長い間使っていないものから捨てる
+//   TIPS:同じフレームで使ったものは捨てない(その間は量を超える)
+//
+
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
+#include <cinder/gl/Fbo.h>
+
+
+namespace ngs { namespace UI {
+
+class LayerCache
+  : private boost::noncopyable
+{
+  struct Entry
+  {
+    ci::gl::FboRef fbo;
+    u_int version    = 0;
+    u_int used_frame = 0;
+  };
+
+  std::unordered_map<u_int, Entry> entries_;
+
+  size_t budget_;
+  size_t used_bytes_ = 0;
+  u_int frame_ = 0;
+
+  // 描き直した数と捨てた数
+  u_int render_num_ = 0;
+  u_int evict_num_  = 0;
+
+
+  static size_t fboBytes(const ci::gl::FboRef& fbo) noexcept
+  {
+    return size_t(fbo->getWidth()) * size_t(fbo->getHeight()) * 4;
+  }
+
+  // 量を超えている間、古いものから捨てる
+  void evict() noexcept
+  {
+    while (used_bytes_ > budget_)
+    {
+      auto oldest = std::end(entries_);
+      for (auto it = std::begin(entries_); it != std::end(entries_); ++it)
+      {
+        if (it->second.used_frame == frame_) continue;
+        if ((oldest == std::end(entries_)) || (it->second.used_frame < oldest->second.used_frame))
+        {
+          oldest = it;
+        }
+      }
+      if (oldest == std::end(entries_)) break;
+
+      used_bytes_ -= fboBytes(oldest->second.fbo);
+      entries_.erase(oldest);
+      evict_num_ += 1;
+    }
+  }
+
+
+public:
+  // budget: 使えるメモリの量(バイト)
+  explicit LayerCache(const size_t budget) noexcept
+    : budget_(budget)
+  {}
+
+
+  // フレームの始めに呼ぶ
+  void nextFrame() noexcept
+  {
+    frame_ += 1;
+  }
+
+  // レイヤーのFBOを返す
+  //   render: 描き直しが必要ならtrue
+  ci::gl::FboRef acquire(const u_int id, const u_int version, const ci::ivec2& size, bool& render) noexcept
+  {
+    auto& entry = entries_[id];
+    if (entry.fbo && (entry.fbo->getSize() != size))
+    {
+      used_bytes_ -= fboBytes(entry.fbo);
+      entry.fbo.reset();
+    }
+
+    render = !entry.fbo || (entry.version != version);
+    if (!entry.fbo)
+    {
+      // TIPS:ソフトウェア実装(Mesa)でも使えるように、深度無しのRGBA8
+      entry.fbo = ci::gl::Fbo::create(size.x, size.y, ci::gl::Fbo::Format().disableDepth());
+      used_bytes_ += fboBytes(entry.fbo);
+    }
+    entry.version    = version;
+    entry.used_frame = frame_;
+    if (render) render_num_ += 1;
+
+    auto fbo = entry.fbo;
+    evict();
+    return fbo;
+  }
+
+
+  void setBudget(const size_t budget) noexcept
+  {
+    budget_ = budget;
+    evict();
+  }
+
+  size_t getBudget() const noexcept
+  {
+    return budget_;
+  }
+
+  size_t getUsedBytes() const noexcept
+  {
+    return used_bytes_;
+  }
+
+  u_int getLayerNum() const noexcept
+  {
+    return u_int(entries_.size());
+  }
+
+  u_int getRenderNum() const noexcept
+  {
+    return render_num_;
+  }
+
+  u_int getEvictNum() const noexcept
+  {
+    return evict_num_;
+  }
+
+};
+
+} }
@@ -0,0 +1,642 @@
+﻿#pragma once
+
+//
+// UI::Widgetの位置・サイズ計算
+//   Widgetの階層を配列に展開して、ループで計算する
+//   計算用の値は深さごとに並べて持ち、同じ深さのWidgetをまとめて計算する
+//   描画やタッチ判定は深さ優先順で辿る
+//
+
+#include <vector>
+#include <array>
+#include "UIWidget.hpp"
+#include "UILayoutKernel.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace ngs { namespace UI {
+
+// 親の情報から位置、サイズを計算
+ci::Rectf calcRect(const ci::Rectf& parent_rect, const ci::vec2& scale,
+                   const ci::Rectf& rect,
+                   const ci::vec2& anchor_min, const ci::vec2& anchor_max,
+                   const ci::vec2& pivot) noexcept
+{
+  ci::vec2 parent_size = parent_rect.getSize();
+
+  // 親のサイズとアンカーから左下・右上の座標を計算
+  ci::vec2 anchor_min_pos = parent_size * anchor_min;
+  ci::vec2 anchor_max_pos = parent_size * anchor_max;
+
+  // 相対座標(スケーリング抜き)
+  ci::vec2 pos  = rect.getUpperLeft() + anchor_min_pos;
+  ci::vec2 size = rect.getLowerRight() + anchor_max_pos - pos;
+
+  // pivotを考慮したスケーリング
+  ci::vec2 d = size * pivot;
+  pos -= d * scale - d;
+  size *= scale;
+
+  ci::vec2 parent_pos = parent_rect.getUpperLeft();
+  return ci::Rectf(pos + parent_pos, pos + size + parent_pos);
+}
+
+
+class Layout
+{
+  // TIPS:計算用の配列は深さ順に並ぶ(以下slot)
+  //      slot 0はCanvas(rootの親)
+  enum Column {
+    RECT_X1,
+    RECT_Y1,
+    RECT_X2,
+    RECT_Y2,
+
+    ANCHOR_MIN_X,
+    ANCHOR_MIN_Y,
+    ANCHOR_MAX_X,
+    ANCHOR_MAX_Y,
+
+    PIVOT_X,
+    PIVOT_Y,
+
+    SCALE_X,
+    SCALE_Y,
+
+    WORLD_X1,
+    WORLD_Y1,
+    WORLD_X2,
+    WORLD_Y2,
+
+    WORLD_SCALE_X,
+    WORLD_SCALE_Y,
+
+    // 部分木全体を囲む矩形(描画の間引き用)
+    BOUNDS_X1,
+    BOUNDS_Y1,
+    BOUNDS_X2,
+    BOUNDS_Y2,
+
+    COLUMN_NUM
+  };
+
+  std::array<std::vector<float>, COLUMN_NUM> columns_;
+
+  std::vector<Widget*> widgets_;
+  // 親のslot
+  std::vector<u_int> parent_;
+  // 深さごとの開始slot
+  std::vector<u_int> level_begin_;
+
+  // 深さ優先順(以下position) → slot
+  std::vector<u_int> order_;
+  // 部分木の終端(このpositionの手前まで)
+  std::vector<u_int> subtree_end_;
+  // 深さ
+  std::vector<u_int> depth_;
+  // 親のposition(rootは-1)
+  std::vector<int> parent_position_;
+
+  // 並列計算用の分割
+  //   TIPS:同じ深さの中では部分木ごとにslotが連続している
+  struct Task
+  {
+    // 深さごとのslotの範囲
+    std::vector<u_int> begin;
+    std::vector<u_int> end;
+    // 部分木の根の深さ
+    u_int depth;
+  };
+  std::vector<Task> tasks_;
+  // 分割の根元(先に一つずつ計算する)
+  std::vector<u_int> task_roots_;
+  // 分割した時の粒度(0なら未分割)
+  u_int task_grain_ = 0;
+
+  ThreadPool* pool_ = nullptr;
+  u_int threshold_  = 0;
+
+  // 前回のclearChanged()から計算し直した範囲(深さ優先順)
+  std::vector<std::pair<u_int, u_int>> changed_;
+  bool changed_all_ = true;
+
+
+  float* column(const Column column) noexcept
+  {
+    return columns_[column].data();
+  }
+
+  const float* column(const Column column) const noexcept
+  {
+    return columns_[column].data();
+  }
+
+  LayoutColumns getColumns() noexcept
+  {
+    return {
+      parent_.data(),
+
+      column(RECT_X1), column(RECT_Y1), column(RECT_X2), column(RECT_Y2),
+      column(ANCHOR_MIN_X), column(ANCHOR_MIN_Y), column(ANCHOR_MAX_X), column(ANCHOR_MAX_Y),
+      column(PIVOT_X), column(PIVOT_Y),
+      column(SCALE_X), column(SCALE_Y),
+
+      column(WORLD_X1), column(WORLD_Y1), column(WORLD_X2), column(WORLD_Y2),
+      column(WORLD_SCALE_X), column(WORLD_SCALE_Y),
+
+      column(BOUNDS_X1), column(BOUNDS_Y1), column(BOUNDS_X2), column(BOUNDS_Y2),
+    };
+  }
+
+
+  // 深さ優先順に列挙
+  static void addWidget(std::vector<Widget*>& widgets, std::vector<int>& parents, std::vector<u_int>& depths,
+                        std::vector<u_int>& subtree_end,
+                        Widget* widget, const int parent, const u_int depth) noexcept
+  {
+    u_int position = u_int(widgets.size());
+    widget->setLayoutIndex(position);
+
+    widgets.push_back(widget);
+    parents.push_back(parent);
+    depths.push_back(depth);
+    subtree_end.push_back(0);
+
+    for (const auto& child : widget->getChilds())
+    {
+      addWidget(widgets, parents, depths, subtree_end, child, position, depth + 1);
+    }
+
+    subtree_end[position] = u_int(widgets.size());
+  }
+
+  // Widgetの値を写す
+  void copySource(const u_int slot) noexcept
+  {
+    const Widget& widget = *widgets_[slot];
+
+    const auto& rect = widget.getRect();
+    columns_[RECT_X1][slot] = rect.x1;
+    columns_[RECT_Y1][slot] = rect.y1;
+    columns_[RECT_X2][slot] = rect.x2;
+    columns_[RECT_Y2][slot] = rect.y2;
+
+    const auto& anchor_min = widget.getAnchorMin();
+    columns_[ANCHOR_MIN_X][slot] = anchor_min.x;
+    columns_[ANCHOR_MIN_Y][slot] = anchor_min.y;
+
+    const auto& anchor_max = widget.getAnchorMax();
+    columns_[ANCHOR_MAX_X][slot] = anchor_max.x;
+    columns_[ANCHOR_MAX_Y][slot] = anchor_max.y;
+
+    const auto& pivot = widget.getPivot();
+    columns_[PIVOT_X][slot] = pivot.x;
+    columns_[PIVOT_Y][slot] = pivot.y;
+
+    const auto& scale = widget.getScale();
+    columns_[SCALE_X][slot] = scale.x;
+    columns_[SCALE_Y][slot] = scale.y;
+  }
+
+  // Widgetの値が前回の計算時から変わったか
+  bool isSourceChanged(const u_int slot) const noexcept
+  {
+    const Widget& widget = *widgets_[slot];
+    if (widget.isLayoutDirty()) return true;
+    if (!widget.isLayoutWatched()) return false;
+
+    const auto& rect       = widget.getRect();
+    const auto& anchor_min = widget.getAnchorMin();
+    const auto& anchor_max = widget.getAnchorMax();
+    const auto& pivot      = widget.getPivot();
+    const auto& scale      = widget.getScale();
+
+    const auto& c = columns_;
+    return (rect.x1 != c[RECT_X1][slot]) || (rect.y1 != c[RECT_Y1][slot])
+        || (rect.x2 != c[RECT_X2][slot]) || (rect.y2 != c[RECT_Y2][slot])
+        || (anchor_min.x != c[ANCHOR_MIN_X][slot]) || (anchor_min.y != c[ANCHOR_MIN_Y][slot])
+        || (anchor_max.x != c[ANCHOR_MAX_X][slot]) || (anchor_max.y != c[ANCHOR_MAX_Y][slot])
+        || (pivot.x != c[PIVOT_X][slot]) || (pivot.y != c[PIVOT_Y][slot])
+        || (scale.x != c[SCALE_X][slot]) || (scale.y != c[SCALE_Y][slot]);
+  }
+
+  // 部分木のうち、変更のあったWidgetの値だけ写す
+  void gather(u_int position) noexcept
+  {
+    u_int end = subtree_end_[position];
+    while (position < end)
+    {
+      u_int slot = order_[position];
+      auto* widget = widgets_[slot];
+      if (isSourceChanged(slot))
+      {
+        copySource(slot);
+        widget->clearLayoutDirty();
+      }
+
+      if (widget->hasDirtyDescendant())
+      {
+        widget->clearSubtreeDirty();
+        position += 1;
+      }
+      else
+      {
+        // TIPS:変更の無い部分木は飛ばす
+        position = subtree_end_[position];
+      }
+    }
+  }
+
+  void setCanvasRect(const ci::Rectf& canvas_rect) noexcept
+  {
+    columns_[WORLD_X1][0] = canvas_rect.x1;
+    columns_[WORLD_Y1][0] = canvas_rect.y1;
+    columns_[WORLD_X2][0] = canvas_rect.x2;
+    columns_[WORLD_Y2][0] = canvas_rect.y2;
+
+    columns_[WORLD_SCALE_X][0] = 1.0f;
+    columns_[WORLD_SCALE_Y][0] = 1.0f;
+  }
+
+  // 自分の矩形で初期化
+  // TIPS:左右・上下が逆の矩形もある
+  void initBounds(const u_int slot) noexcept
+  {
+    auto& c = columns_;
+    c[BOUNDS_X1][slot] = std::min(c[WORLD_X1][slot], c[WORLD_X2][slot]);
+    c[BOUNDS_Y1][slot] = std::min(c[WORLD_Y1][slot], c[WORLD_Y2][slot]);
+    c[BOUNDS_X2][slot] = std::max(c[WORLD_X1][slot], c[WORLD_X2][slot]);
+    c[BOUNDS_Y2][slot] = std::max(c[WORLD_Y1][slot], c[WORLD_Y2][slot]);
+  }
+
+  // 子供の範囲を親に足す
+  void mergeBounds(const u_int slot, const u_int parent) noexcept
+  {
+    auto& c = columns_;
+    c[BOUNDS_X1][parent] = std::min(c[BOUNDS_X1][parent], c[BOUNDS_X1][slot]);
+    c[BOUNDS_Y1][parent] = std::min(c[BOUNDS_Y1][parent], c[BOUNDS_Y1][slot]);
+    c[BOUNDS_X2][parent] = std::max(c[BOUNDS_X2][parent], c[BOUNDS_X2][slot]);
+    c[BOUNDS_Y2][parent] = std::max(c[BOUNDS_Y2][parent], c[BOUNDS_Y2][slot]);
+  }
+
+  // TIPS:slotは深さ順なので、後ろから親へ足していけば子供が先に確定する
+  //      自分の矩形はresolveRectsが書いている
+  //      兄弟はslotが続いているので、親へはまとめて一度だけ書く
+  void solveBoundsAll() noexcept
+  {
+    float* x1 = column(BOUNDS_X1);
+    float* y1 = column(BOUNDS_Y1);
+    float* x2 = column(BOUNDS_X2);
+    float* y2 = column(BOUNDS_Y2);
+    const u_int* parent = parent_.data();
+
+    u_int slot = u_int(widgets_.size()) - 1;
+    while (slot > 1)
+    {
+      u_int p = parent[slot];
+      float px1 = x1[p];
+      float py1 = y1[p];
+      float px2 = x2[p];
+      float py2 = y2[p];
+      for (; (slot > 1) && (parent[slot] == p); --slot)
+      {
+        px1 = std::min(px1, x1[slot]);
+        py1 = std::min(py1, y1[slot]);
+        px2 = std::max(px2, x2[slot]);
+        py2 = std::max(py2, y2[slot]);
+      }
+      x1[p] = px1;
+      y1[p] = py1;
+      x2[p] = px2;
+      y2[p] = py2;
+    }
+  }
+
+  // 部分木[begin, end)と、その先祖を計算し直す
+  void solveBounds(const u_int begin, const u_int end) noexcept
+  {
+    for (u_int i = begin; i < end; ++i)
+    {
+      initBounds(order_[i]);
+    }
+    // TIPS:深さ優先順の逆から辿ると子孫が先に確定する
+    for (u_int i = end - 1; i > begin; --i)
+    {
+      u_int slot = order_[i];
+      mergeBounds(slot, parent_[slot]);
+    }
+
+    // 先祖は子供から集め直す
+    for (int position = parent_position_[begin]; position >= 0; position = parent_position_[position])
+    {
+      u_int slot = order_[position];
+      initBounds(slot);
+      for (u_int child = position + 1; child < subtree_end_[position]; child = subtree_end_[child])
+      {
+        mergeBounds(order_[child], slot);
+      }
+    }
+  }
+
+
+  // 全部計算
+  // TIPS:深さごとにまとめて計算できる
+  void solveAll() noexcept
+  {
+    auto columns = getColumns();
+    for (size_t i = 1; i < level_begin_.size(); ++i)
+    {
+      resolveRects(columns, level_begin_[i - 1], level_begin_[i]);
+    }
+  }
+
+  // 部分木を粒度以下に分割する
+  void splitTask(const u_int position, const u_int grain) noexcept
+  {
+    u_int end = subtree_end_[position];
+    if (((end - position) <= grain) || ((position + 1) == end))
+    {
+      addTask(position);
+      return;
+    }
+
+    task_roots_.push_back(order_[position]);
+    for (u_int child = position + 1; child < end; child = subtree_end_[child])
+    {
+      splitTask(child, grain);
+    }
+  }
+
+  void addTask(const u_int position) noexcept
+  {
+    Task task;
+    task.depth = depth_[position];
+
+    u_int end = subtree_end_[position];
+    for (u_int i = position; i < end; ++i)
+    {
+      u_int level = depth_[i] - task.depth;
+      u_int slot  = order_[i];
+      if (level == task.begin.size())
+      {
+        task.begin.push_back(slot);
+        task.end.push_back(slot + 1);
+      }
+      else
+      {
+        task.begin[level] = std::min(task.begin[level], slot);
+        task.end[level]   = std::max(task.end[level], slot + 1);
+      }
+    }
+
+    tasks_.push_back(std::move(task));
+  }
+
+  // 全部計算(部分木ごとに並列)
+  void solveAll(ThreadPool& pool, const u_int grain) noexcept
+  {
+    if (task_grain_ != grain)
+    {
+      tasks_.clear();
+      task_roots_.clear();
+      splitTask(0, grain);
+      task_grain_ = grain;
+    }
+
+    auto columns = getColumns();
+    for (auto slot : task_roots_)
+    {
+      resolveRect(columns, slot);
+    }
+
+    pool.parallelFor(u_int(tasks_.size()), [this, &columns](const u_int index) {
+        const auto& task = tasks_[index];
+        for (size_t i = 0; i < task.begin.size(); ++i)
+        {
+          resolveRects(columns, task.begin[i], task.end[i]);
+        }
+      });
+  }
+
+  void solveAll(ThreadPool* pool, const u_int threshold) noexcept
+  {
+    if (pool && (pool->size() > 1) && (size() >= threshold))
+    {
+      // TIPS:スレッド数より少し多めに分けると偏りが減る
+      u_int grain = std::max(size() / (pool->size() * 4), 1u);
+      solveAll(*pool, grain);
+    }
+    else
+    {
+      solveAll();
+    }
+    solveBoundsAll();
+  }
+
+  // 部分木[begin, end)を計算
+  // TIPS:親の計算は済んでいる前提
+  void solve(const u_int begin, const u_int end) noexcept
+  {
+    auto columns = getColumns();
+    for (u_int i = begin; i < end; ++i)
+    {
+      resolveRect(columns, order_[i]);
+    }
+    solveBounds(begin, end);
+
+    if (changed_all_) return;
+    // TIPS:範囲が増えすぎたら全部変わった扱い
+    if (changed_.size() >= 256)
+    {
+      changed_all_ = true;
+      changed_.clear();
+      return;
+    }
+    changed_.push_back({ begin, end });
+  }
+
+
+public:
+  Layout() = default;
+
+
+  // 並列計算の有効・無効
+  //   pool: nullptrなら並列計算しない
+  //   threshold: Widgetの数がこれより少なければ並列計算しない
+  void enableParallel(ThreadPool* pool, const u_int threshold) noexcept
+  {
+    pool_      = pool;
+    threshold_ = threshold;
+    task_grain_ = 0;
+  }
+
+
+  // Widgetの階層から配列を作り直す
+  void compile(Widget* root_widget, const ci::Rectf& canvas_rect) noexcept
+  {
+    // 深さ優先順に並べる
+    std::vector<Widget*> widgets;
+    std::vector<int> parents;
+    subtree_end_.clear();
+    depth_.clear();
+    addWidget(widgets, parents, depth_, subtree_end_, root_widget, -1, 0);
+    parent_position_ = parents;
+
+    // 深さごとの数からslotの開始位置を決める
+    u_int num = u_int(widgets.size());
+    u_int depth_num = *std::max_element(std::begin(depth_), std::end(depth_)) + 1;
+    level_begin_.assign(depth_num + 1, 0);
+    for (auto depth : depth_)
+    {
+      level_begin_[depth + 1] += 1;
+    }
+    level_begin_[0] = 1;
+    for (u_int i = 1; i <= depth_num; ++i)
+    {
+      level_begin_[i] += level_begin_[i - 1];
+    }
+
+    // TIPS:同じ深さの中では深さ優先順のまま並べるので
+    //      兄弟は隣り合う
+    std::vector<u_int> next(std::begin(level_begin_), std::end(level_begin_) - 1);
+    order_.resize(num);
+    widgets_.assign(num + 1, nullptr);
+    parent_.assign(num + 1, 0);
+    for (auto& column : columns_)
+    {
+      column.assign(num + 1, 0.0f);
+    }
+
+    for (u_int i = 0; i < num; ++i)
+    {
+      u_int slot = next[depth_[i]]++;
+      order_[i] = slot;
+
+      widgets_[slot] = widgets[i];
+      parent_[slot]  = (parents[i] < 0) ? 0 : order_[parents[i]];
+
+      copySource(slot);
+
+      auto* widget = widgets[i];
+      widget->clearLayoutDirty();
+      widget->clearSubtreeDirty();
+      widget->clearTreeChanged();
+    }
+
+    task_grain_ = 0;
+    changed_all_ = true;
+    changed_.clear();
+
+    setCanvasRect(canvas_rect);
+    solveAll(pool_, threshold_);
+  }
+
+  // 変更のあった部分だけ計算し直す
+  //   all: Canvasのサイズが変わった時などは全部計算
+  void update(const ci::Rectf& canvas_rect, const bool all) noexcept
+  {
+    setCanvasRect(canvas_rect);
+
+    u_int num = size();
+    if (all)
+    {
+      gather(0);
+      solveAll(pool_, threshold_);
+      changed_all_ = true;
+      return;
+    }
+
+    u_int position = 0;
+    while (position < num)
+    {
+      u_int slot = order_[position];
+      auto* widget = widgets_[slot];
+      if (isSourceChanged(slot))
+      {
+        // 子孫も含めて計算し直す
+        u_int end = subtree_end_[position];
+        gather(position);
+        if (position == 0)
+        {
+          // rootが変わった時はまとめて計算
+          solveAll(pool_, threshold_);
+          changed_all_ = true;
+        }
+        else
+        {
+          solve(position, end);
+        }
+        position = end;
+      }
+      else if (widget->hasDirtyDescendant())
+      {
+        widget->clearSubtreeDirty();
+        position += 1;
+      }
+      else
+      {
+        position = subtree_end_[position];
+      }
+    }
+  }
+
+
+  // 以下、引数は深さ優先順の番号
+  u_int size() const noexcept
+  {
+    return u_int(order_.size());
+  }
+
+  Widget* widget(const u_int index) const noexcept
+  {
+    return widgets_[order_[index]];
+  }
+
+  u_int subtreeEnd(const u_int index) const noexcept
+  {
+    return subtree_end_[index];
+  }
+
+  ci::Rectf worldRect(const u_int index) const noexcept
+  {
+    u_int slot = order_[index];
+    return ci::Rectf(columns_[WORLD_X1][slot], columns_[WORLD_Y1][slot],
+                     columns_[WORLD_X2][slot], columns_[WORLD_Y2][slot]);
+  }
+
+  ci::vec2 worldScale(const u_int index) const noexcept
+  {
+    u_int slot = order_[index];
+    return ci::vec2(columns_[WORLD_SCALE_X][slot], columns_[WORLD_SCALE_Y][slot]);
+  }
+
+  // 部分木全体を囲む矩形(正規化済み)
+  ci::Rectf subtreeBounds(const u_int index) const noexcept
+  {
+    u_int slot = order_[index];
+    return ci::Rectf(columns_[BOUNDS_X1][slot], columns_[BOUNDS_Y1][slot],
+                     columns_[BOUNDS_X2][slot], columns_[BOUNDS_Y2][slot]);
+  }
+
+
+  // 計算し直した範囲
+  //   TIPS:計算結果を別の所で使う時に差分だけ反映する
+  bool isAllChanged() const noexcept
+  {
+    return changed_all_;
+  }
+
+  const std::vector<std::pair<u_int, u_int>>& getChangedRanges() const noexcept
+  {
+    return changed_;
+  }
+
+  void clearChanged() noexcept
+  {
+    changed_all_ = false;
+    changed_.clear();
+  }
+
+};
+
+} }
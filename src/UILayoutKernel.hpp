@@ -0,0 +1,269 @@
+﻿#pragma once
+
+//
+// UI::Widgetの位置・サイズ計算(まとめて計算する版)
+//   AVX2/SSE2/NEONのどれを使うかはコンパイル時に決まる
+//   TIPS:演算の順番をcalcRectと揃えているので結果は完全に一致する
+//        スカラー版がFMAにまとめられると一致しなくなるので
+//        -ffp-contract=offでビルドする事
+//        使える実装は全部定義しておく(UILayoutKernelTest.cppで比べる)
+//
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NGS_LAYOUT_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define NGS_LAYOUT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NGS_LAYOUT_NEON
+#endif
+
+
+namespace ngs { namespace UI {
+
+// 計算に使う配列一式
+//   成分ごとにバラバラの配列(SoA)
+//   parentは親の番号。親の計算結果はworld_*から読む
+struct LayoutColumns
+{
+  const u_int* parent;
+
+  const float* rect_x1;
+  const float* rect_y1;
+  const float* rect_x2;
+  const float* rect_y2;
+
+  const float* anchor_min_x;
+  const float* anchor_min_y;
+  const float* anchor_max_x;
+  const float* anchor_max_y;
+
+  const float* pivot_x;
+  const float* pivot_y;
+
+  const float* scale_x;
+  const float* scale_y;
+
+  float* world_x1;
+  float* world_y1;
+  float* world_x2;
+  float* world_y2;
+
+  float* world_scale_x;
+  float* world_scale_y;
+
+  // 自分の矩形(左右・上下を揃えたもの)
+  //   TIPS:子孫の分はUI::Layoutが後で足す
+  float* bounds_x1;
+  float* bounds_y1;
+  float* bounds_x2;
+  float* bounds_y2;
+};
+
+
+namespace LayoutKernel {
+
+// 一要素ずつ計算
+struct Scalar
+{
+  using Reg = float;
+  static constexpr u_int width = 1;
+
+  static Reg load(const float* p) noexcept { return *p; }
+  static void store(float* p, const Reg v) noexcept { *p = v; }
+
+  static Reg add(const Reg a, const Reg b) noexcept { return a + b; }
+  static Reg sub(const Reg a, const Reg b) noexcept { return a - b; }
+  static Reg mul(const Reg a, const Reg b) noexcept { return a * b; }
+
+  // TIPS:std::min/std::maxと同じ結果(どちらを返すかも含めて)
+  static Reg min(const Reg a, const Reg b) noexcept { return std::min(a, b); }
+  static Reg max(const Reg a, const Reg b) noexcept { return std::max(a, b); }
+
+  static Reg gather(const float* base, const u_int* index) noexcept { return base[*index]; }
+};
+
+#if defined(NGS_LAYOUT_AVX2)
+
+struct Avx2
+{
+  using Reg = __m256;
+  static constexpr u_int width = 8;
+
+  static Reg load(const float* p) noexcept { return _mm256_loadu_ps(p); }
+  static void store(float* p, const Reg v) noexcept { _mm256_storeu_ps(p, v); }
+
+  static Reg add(const Reg a, const Reg b) noexcept { return _mm256_add_ps(a, b); }
+  static Reg sub(const Reg a, const Reg b) noexcept { return _mm256_sub_ps(a, b); }
+  static Reg mul(const Reg a, const Reg b) noexcept { return _mm256_mul_ps(a, b); }
+
+  // TIPS:minpsは(a < b) ? a : bなので、std::minに合わせて引数を入れ替える
+  static Reg min(const Reg a, const Reg b) noexcept { return _mm256_min_ps(b, a); }
+  static Reg max(const Reg a, const Reg b) noexcept { return _mm256_max_ps(b, a); }
+
+  static Reg gather(const float* base, const u_int* index) noexcept
+  {
+    __m256i i = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index));
+    return _mm256_i32gather_ps(base, i, 4);
+  }
+};
+
+#endif
+
+#if defined(NGS_LAYOUT_SSE2)
+
+struct Sse2
+{
+  using Reg = __m128;
+  static constexpr u_int width = 4;
+
+  static Reg load(const float* p) noexcept { return _mm_loadu_ps(p); }
+  static void store(float* p, const Reg v) noexcept { _mm_storeu_ps(p, v); }
+
+  static Reg add(const Reg a, const Reg b) noexcept { return _mm_add_ps(a, b); }
+  static Reg sub(const Reg a, const Reg b) noexcept { return _mm_sub_ps(a, b); }
+  static Reg mul(const Reg a, const Reg b) noexcept { return _mm_mul_ps(a, b); }
+
+  static Reg min(const Reg a, const Reg b) noexcept { return _mm_min_ps(b, a); }
+  static Reg max(const Reg a, const Reg b) noexcept { return _mm_max_ps(b, a); }
+
+  static Reg gather(const float* base, const u_int* index) noexcept
+  {
+    return _mm_set_ps(base[index[3]], base[index[2]], base[index[1]], base[index[0]]);
+  }
+};
+
+#elif defined(NGS_LAYOUT_NEON)
+
+struct Neon
+{
+  using Reg = float32x4_t;
+  static constexpr u_int width = 4;
+
+  static Reg load(const float* p) noexcept { return vld1q_f32(p); }
+  static void store(float* p, const Reg v) noexcept { vst1q_f32(p, v); }
+
+  static Reg add(const Reg a, const Reg b) noexcept { return vaddq_f32(a, b); }
+  static Reg sub(const Reg a, const Reg b) noexcept { return vsubq_f32(a, b); }
+  static Reg mul(const Reg a, const Reg b) noexcept { return vmulq_f32(a, b); }
+
+  // TIPS:vminq_f32は-0と+0やNaNの扱いがstd::minと違うので比較して選ぶ
+  static Reg min(const Reg a, const Reg b) noexcept { return vbslq_f32(vcltq_f32(b, a), b, a); }
+  static Reg max(const Reg a, const Reg b) noexcept { return vbslq_f32(vcltq_f32(a, b), b, a); }
+
+  static Reg gather(const float* base, const u_int* index) noexcept
+  {
+    float v[4] = { base[index[0]], base[index[1]], base[index[2]], base[index[3]] };
+    return vld1q_f32(v);
+  }
+};
+
+#endif
+
+// 一番速いもの
+#if defined(NGS_LAYOUT_AVX2)
+using Simd = Avx2;
+#elif defined(NGS_LAYOUT_SSE2)
+using Simd = Sse2;
+#elif defined(NGS_LAYOUT_NEON)
+using Simd = Neon;
+#else
+// SIMD無し
+using Simd = Scalar;
+#endif
+
+
+// index番目からS::width個を計算
+// TIPS:calcRectと同じ順番で計算する事
+template<typename S>
+void resolve(const LayoutColumns& c, const u_int index) noexcept
+{
+  using Reg = typename S::Reg;
+
+  const u_int* parent = c.parent + index;
+
+  Reg parent_x1 = S::gather(c.world_x1, parent);
+  Reg parent_y1 = S::gather(c.world_y1, parent);
+  Reg parent_x2 = S::gather(c.world_x2, parent);
+  Reg parent_y2 = S::gather(c.world_y2, parent);
+
+  Reg scale_x = S::mul(S::gather(c.world_scale_x, parent), S::load(c.scale_x + index));
+  Reg scale_y = S::mul(S::gather(c.world_scale_y, parent), S::load(c.scale_y + index));
+
+  // 親のサイズとアンカーから左下・右上の座標を計算
+  Reg parent_w = S::sub(parent_x2, parent_x1);
+  Reg parent_h = S::sub(parent_y2, parent_y1);
+
+  Reg anchor_min_x = S::mul(parent_w, S::load(c.anchor_min_x + index));
+  Reg anchor_min_y = S::mul(parent_h, S::load(c.anchor_min_y + index));
+  Reg anchor_max_x = S::mul(parent_w, S::load(c.anchor_max_x + index));
+  Reg anchor_max_y = S::mul(parent_h, S::load(c.anchor_max_y + index));
+
+  // 相対座標(スケーリング抜き)
+  Reg pos_x = S::add(S::load(c.rect_x1 + index), anchor_min_x);
+  Reg pos_y = S::add(S::load(c.rect_y1 + index), anchor_min_y);
+  Reg size_x = S::sub(S::add(S::load(c.rect_x2 + index), anchor_max_x), pos_x);
+  Reg size_y = S::sub(S::add(S::load(c.rect_y2 + index), anchor_max_y), pos_y);
+
+  // pivotを考慮したスケーリング
+  Reg d_x = S::mul(size_x, S::load(c.pivot_x + index));
+  Reg d_y = S::mul(size_y, S::load(c.pivot_y + index));
+  pos_x = S::sub(pos_x, S::sub(S::mul(d_x, scale_x), d_x));
+  pos_y = S::sub(pos_y, S::sub(S::mul(d_y, scale_y), d_y));
+  size_x = S::mul(size_x, scale_x);
+  size_y = S::mul(size_y, scale_y);
+
+  Reg x1 = S::add(pos_x, parent_x1);
+  Reg y1 = S::add(pos_y, parent_y1);
+  Reg x2 = S::add(S::add(pos_x, size_x), parent_x1);
+  Reg y2 = S::add(S::add(pos_y, size_y), parent_y1);
+
+  S::store(c.world_x1 + index, x1);
+  S::store(c.world_y1 + index, y1);
+  S::store(c.world_x2 + index, x2);
+  S::store(c.world_y2 + index, y2);
+
+  S::store(c.world_scale_x + index, scale_x);
+  S::store(c.world_scale_y + index, scale_y);
+
+  // TIPS:レジスタにあるうちに書いておく(後で読み直さない)
+  S::store(c.bounds_x1 + index, S::min(x1, x2));
+  S::store(c.bounds_y1 + index, S::min(y1, y2));
+  S::store(c.bounds_x2 + index, S::max(x1, x2));
+  S::store(c.bounds_y2 + index, S::max(y1, y2));
+}
+
+}
+
+
+// [begin, end)をまとめて計算
+// TIPS:範囲内に親子関係があってはならない(同じ深さのWidgetを並べて渡す)
+void resolveRects(const LayoutColumns& columns, u_int begin, const u_int end) noexcept
+{
+  using LayoutKernel::Simd;
+
+  for (; (begin + Simd::width) <= end; begin += Simd::width)
+  {
+    LayoutKernel::resolve<Simd>(columns, begin);
+  }
+
+  // 端数
+  for (; begin < end; ++begin)
+  {
+    LayoutKernel::resolve<LayoutKernel::Scalar>(columns, begin);
+  }
+}
+
+// 一つだけ計算
+void resolveRect(const LayoutColumns& columns, const u_int index) noexcept
+{
+  LayoutKernel::resolve<LayoutKernel::Scalar>(columns, index);
+}
+
+} }
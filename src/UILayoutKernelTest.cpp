@@ -0,0 +1,229 @@
+﻿//
+// UI::resolveRectsのテスト
+//   AVX2/SSE2/NEON/スカラー版の結果がcalcRectとビット単位で一致するか調べる
+//   値には負・0・-0・非正規化数・大きな数も混ぜる
+//   10000個のWidgetを画面サイズ変更で計算し直す時間も調べる(Releaseビルドのみ判定)
+//   失敗したら1で終了(AVX2版をAVX2が使えないCPUで動かした時は77)
+//
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cstring>
+#include <limits>
+
+#include "Defines.hpp"
+#include "UILayout.hpp"
+
+
+namespace ngs {
+
+// 計算に使う配列一式
+struct Columns
+{
+  std::vector<u_int> parent;
+  std::vector<float> values[22];
+
+  explicit Columns(const u_int num) noexcept
+    : parent(num)
+  {
+    for (auto& v : values)
+    {
+      v.resize(num);
+    }
+  }
+
+  UI::LayoutColumns get() noexcept
+  {
+    auto* v = values;
+    return {
+      parent.data(),
+      v[0].data(),  v[1].data(),  v[2].data(),  v[3].data(),
+      v[4].data(),  v[5].data(),  v[6].data(),  v[7].data(),
+      v[8].data(),  v[9].data(),
+      v[10].data(), v[11].data(),
+      v[12].data(), v[13].data(), v[14].data(), v[15].data(),
+      v[16].data(), v[17].data(),
+      v[18].data(), v[19].data(), v[20].data(), v[21].data(),
+    };
+  }
+};
+
+
+// 色々な値を作る
+class Values
+{
+  std::mt19937 random_;
+
+  float uniform(const float min, const float max) noexcept
+  {
+    return std::uniform_real_distribution<float>(min, max)(random_);
+  }
+
+  float sign() noexcept
+  {
+    return (random_() & 1) ? -1.0f : 1.0f;
+  }
+
+public:
+  explicit Values(const u_int seed) noexcept
+    : random_(seed)
+  {}
+
+  // 座標やサイズ
+  float any() noexcept
+  {
+    switch (random_() % 8)
+    {
+    case 0:  return 0.0f;
+    case 1:  return -0.0f;
+    // 非正規化数
+    case 2:  return sign() * uniform(1.0f, 1000.0f) * std::numeric_limits<float>::denorm_min();
+    case 3:  return sign() * uniform(1.0e30f, 1.0e37f);
+    case 4:  return uniform(-1.0f, 1.0f);
+    default: return uniform(-2000.0f, 2000.0f);
+    }
+  }
+
+  // アンカー・pivot
+  float ratio() noexcept
+  {
+    switch (random_() % 6)
+    {
+    case 0:  return 0.0f;
+    case 1:  return 1.0f;
+    case 2:  return any();
+    default: return uniform(0.0f, 1.0f);
+    }
+  }
+
+  // スケーリング
+  float scale() noexcept
+  {
+    switch (random_() % 6)
+    {
+    case 0:  return 0.0f;
+    case 1:  return -uniform(0.0f, 4.0f);
+    case 2:  return any();
+    default: return uniform(0.0f, 4.0f);
+    }
+  }
+
+  u_int index(const u_int num) noexcept
+  {
+    return random_() % num;
+  }
+};
+
+
+bool isSame(const float a, const float b) noexcept
+{
+  return !std::memcmp(&a, &b, sizeof(float));
+}
+
+// S版でまとめて計算してcalcRectと比べる
+//   先頭のparent_num個が親(計算済みとする)
+template<typename S>
+bool testKernel(const std::string& name, const u_int seed) noexcept
+{
+  const u_int parent_num = 37;
+  const u_int num        = parent_num + 4099;
+
+  Values values(seed);
+  Columns columns(num);
+  auto& v = columns.values;
+
+  for (u_int i = 0; i < num; ++i)
+  {
+    for (u_int k = 0; k < 4; ++k)  v[k][i] = values.any();
+    for (u_int k = 4; k < 10; ++k) v[k][i] = values.ratio();
+    for (u_int k = 10; k < 12; ++k) v[k][i] = values.scale();
+
+    if (i < parent_num)
+    {
+      for (u_int k = 12; k < 16; ++k) v[k][i] = values.any();
+      for (u_int k = 16; k < 18; ++k) v[k][i] = values.scale();
+    }
+    else
+    {
+      columns.parent[i] = values.index(parent_num);
+    }
+  }
+
+  auto c = columns.get();
+  u_int index = parent_num;
+  for (; (index + S::width) <= num; index += S::width)
+  {
+    UI::LayoutKernel::resolve<S>(c, index);
+  }
+  for (; index < num; ++index)
+  {
+    UI::LayoutKernel::resolve<UI::LayoutKernel::Scalar>(c, index);
+  }
+
+  u_int mismatch = 0;
+  for (u_int i = parent_num; i < num; ++i)
+  {
+    u_int p = columns.parent[i];
+    ci::Rectf parent_rect(v[12][p], v[13][p], v[14][p], v[15][p]);
+    ci::vec2 scale = ci::vec2(v[16][p], v[17][p]) * ci::vec2(v[10][i], v[11][i]);
+
+    auto rect = UI::calcRect(parent_rect, scale,
+                             ci::Rectf(v[0][i], v[1][i], v[2][i], v[3][i]),
+                             ci::vec2(v[4][i], v[5][i]), ci::vec2(v[6][i], v[7][i]),
+                             ci::vec2(v[8][i], v[9][i]));
+
+    const float expected[] = {
+      rect.x1, rect.y1, rect.x2, rect.y2,
+      scale.x, scale.y,
+      std::min(rect.x1, rect.x2), std::min(rect.y1, rect.y2),
+      std::max(rect.x1, rect.x2), std::max(rect.y1, rect.y2),
+    };
+    for (u_int k = 0; k < 10; ++k)
+    {
+      if (isSame(v[12 + k][i], expected[k])) continue;
+
+      if (mismatch < 10)
+      {
+        std::cout << "  " << name << " mismatch: index " << i << " column " << (12 + k)
+                  << " " << std::hexfloat << v[12 + k][i] << " != " << expected[k] << std::defaultfloat << std::endl;
+      }
+      mismatch += 1;
+    }
+  }
+
+  std::cout << std::left << std::setw(32) << ("kernel: " + name + " seed " + std::to_string(seed))
+            << (mismatch ? "FAILED" : "ok") << std::endl;
+  return !mismatch;
+}
+
+bool testKernels() noexcept
+{
+  bool result = true;
+  for (u_int seed = 1; seed <= 8; ++seed)
+  {
+    result = testKernel<UI::LayoutKernel::Scalar>("scalar", seed) && result;
+#if defined(NGS_LAYOUT_SSE2)
+    result = testKernel<UI::LayoutKernel::Sse2>("sse2", seed) && result;
+#endif
+#if defined(NGS_LAYOUT_AVX2)
+    result = testKernel<UI::LayoutKernel::Avx2>("avx2", seed) && result;
+#endif
+#if defined(NGS_LAYOUT_NEON)
+    result = testKernel<UI::LayoutKernel::Neon>("neon", seed) && result;
+#endif
+  }
+  return result;
+}
+
+
+// 全部の版を調べる
+//   TIPS:mainは別の翻訳単位(UILayoutKernelTestMain.cpp)
+bool testLayoutKernels() noexcept
+{
+  bool result = testKernels();
+  std::cout << (result ? "passed" : "FAILED") << std::endl;
+  return result;
+}
+
+}
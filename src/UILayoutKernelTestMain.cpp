@@ -0,0 +1,29 @@
+﻿//
+// UI::resolveRectsのテストの起動
+//   失敗したら1で終了(AVX2版をAVX2が使えないCPUで動かした時は77)
+//   TIPS:AVX2版はテスト本体だけ-mavx2で作るので、ここでは標準ライブラリも含めて
+//        インライン関数を使わない(AVX2の命令が混ざった実体を先に呼ばないように)
+//
+
+#include <cstdio>
+
+
+namespace ngs {
+
+bool testLayoutKernels() noexcept;
+
+}
+
+
+int main()
+{
+#if defined(NGS_LAYOUT_TEST_AVX2) && defined(__GNUC__)
+  if (!__builtin_cpu_supports("avx2"))
+  {
+    std::puts("AVX2 not supported. skipped");
+    return 77;
+  }
+#endif
+
+  return ngs::testLayoutKernels() ? 0 : 1;
+}
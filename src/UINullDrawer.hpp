@@ -0,0 +1,89 @@
+﻿#pragma once
+
+//
+// 何も描画しないUI::Drawer
+//   ウインドウもOpenGLも無い環境(CIや計測用)で使う
+//   描画関数が呼ばれた回数だけ数えている
+//   TIPS:UI::RenderListには何もしない命令を記録する
+//
+
+#include <boost/noncopyable.hpp>
+#include "UIWidget.hpp"
+#include "UIRenderList.hpp"
+
+
+namespace ngs { namespace UI {
+
+class NullDrawer
+  : private boost::noncopyable
+{
+  u_int draw_num_ = 0;
+
+  DrawFuncTable draw_funcs_;
+
+
+  static void count(void* context, RenderList& list, const UI::Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  {
+    static_cast<NullDrawer*>(context)->draw_num_ += 1;
+    list.addCallback(&NullDrawer::replay, context, widget, rect, scale);
+  }
+
+  static void replay(void*, const UI::Widget&, const ci::Rectf&, const ci::vec2&) noexcept
+  {
+  }
+
+
+public:
+  NullDrawer() noexcept
+  {
+    // TIPS:種類の番号はUI::Drawerと揃える
+    for (const auto* identifier : { "blank", "rect", "fill_rect", "rounded_rect", "rounded_fill_rect", "image", "text" })
+    {
+      draw_funcs_.add(identifier, &NullDrawer::count, this);
+    }
+  }
+
+
+  // TIPS:種類に関係なく同じ関数を返す
+  //      知らない種類は登録する
+  const DrawFunc& getFunc(const Atom& identifier) noexcept
+  {
+    if (!draw_funcs_.has(identifier))
+    {
+      draw_funcs_.add(identifier, &NullDrawer::count, this);
+    }
+    return draw_funcs_.get(identifier);
+  }
+
+
+  // TIPS:値を読まないので何も要求しない
+  PropertySchema getSchema(const Atom&) noexcept
+  {
+    return PropertySchema();
+  }
+
+
+  void addFont(const std::string&) noexcept
+  {
+  }
+
+  // 画像は読み込まない
+  AtlasImage loadImage(const std::string&) noexcept
+  {
+    return { TextureRef(), ci::Rectf(0, 0, 1, 1) };
+  }
+
+
+  u_int getDrawNum() const noexcept
+  {
+    return draw_num_;
+  }
+
+  void resetDrawNum() noexcept
+  {
+    draw_num_ = 0;
+  }
+  
+};
+
+} }
@@ -0,0 +1,185 @@
+﻿#pragma once
+
+//
+// UI::Widgetの個別パラメーター
+//   キーはAtom、値はboost::variantでその場に持つ(ヒープを使わない)
+//   生成時にUI::Drawerの指定する順番に並べ替えておけば、
+//   描画時は番号で直接読める
+//   TIPS:追加すると値の参照は無効になる
+//        文字列を要求された場合はAtomに変換しておく
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <boost/variant.hpp>
+#include "Atom.hpp"
+
+
+// TIPS:OpenGLに依存しないように先行宣言だけ
+namespace cinder { namespace gl { class Texture2d; } }
+
+
+namespace ngs { namespace UI {
+
+using TextureRef = std::shared_ptr<ci::gl::Texture2d>;
+
+// テクスチャとその中の範囲
+struct AtlasImage
+{
+  TextureRef texture;
+  ci::Rectf uv;
+};
+
+using PropertyValue = boost::variant<float, int, double,
+                                     ci::vec2, ci::vec3, ci::Color, ci::Rectf,
+                                     std::string, Atom, TextureRef>;
+
+// 型の番号(PropertyValue::which()の値)
+template<typename T>
+int propertyType() noexcept
+{
+  static const int which = PropertyValue(T()).which();
+  return which;
+}
+
+
+// 描画関数が必要とする値の並び
+//   TIPS:optionalなら、無い時にvalueを使う
+struct PropertySpec
+{
+  Atom key;
+  int type;
+  bool optional;
+  PropertyValue value;
+};
+
+using PropertySchema = std::vector<PropertySpec>;
+
+template<typename T>
+PropertySpec propertySpec(const Atom& key) noexcept
+{
+  return { key, propertyType<T>(), false, T() };
+}
+
+// 省略できる値
+template<typename T>
+PropertySpec propertySpec(const Atom& key, const T& value) noexcept
+{
+  return { key, propertyType<T>(), true, value };
+}
+
+
+class PropertyBlock
+{
+  // TIPS:数は少ないので線形探索で十分
+  std::vector<Atom> keys_;
+  std::vector<PropertyValue> values_;
+
+
+public:
+  PropertyBlock() = default;
+
+
+  // 見つからなければ-1
+  int find(const Atom& key) const noexcept
+  {
+    auto it = std::find(std::begin(keys_), std::end(keys_), key);
+    if (it == std::end(keys_)) return -1;
+
+    return int(std::distance(std::begin(keys_), it));
+  }
+
+  bool has(const Atom& key) const noexcept
+  {
+    return find(key) >= 0;
+  }
+
+
+  template<typename T>
+  void set(const Atom& key, T value) noexcept
+  {
+    int slot = find(key);
+    if (slot < 0)
+    {
+      keys_.push_back(key);
+      values_.push_back(std::move(value));
+      return;
+    }
+
+    values_[slot] = std::move(value);
+  }
+
+  template<typename T>
+  const T& get(const Atom& key) const noexcept
+  {
+    int slot = find(key);
+    assert(slot >= 0);
+    return boost::get<T>(values_[slot]);
+  }
+
+  template<typename T>
+  T& get(const Atom& key) noexcept
+  {
+    int slot = find(key);
+    assert(slot >= 0);
+    return boost::get<T>(values_[slot]);
+  }
+
+  // 番号で読む
+  // TIPS:型はarrangeで確認済み
+  template<typename T>
+  const T& at(const u_int slot) const noexcept
+  {
+    return boost::get<T>(values_[slot]);
+  }
+
+
+  // schemaの順番に並べ替える
+  //   省略された値は既定値で補う
+  //   足りない値や型違いがあればfalse
+  bool arrange(const PropertySchema& schema) noexcept
+  {
+    for (u_int i = 0; i < schema.size(); ++i)
+    {
+      int slot = find(schema[i].key);
+      if (slot < 0)
+      {
+        if (!schema[i].optional) return false;
+
+        keys_.push_back(schema[i].key);
+        values_.push_back(schema[i].value);
+        slot = int(keys_.size()) - 1;
+      }
+
+      auto& value = values_[slot];
+      if ((schema[i].type == propertyType<Atom>()) && (value.which() == propertyType<std::string>()))
+      {
+        value = Atom(boost::get<std::string>(value));
+      }
+      if (value.which() != schema[i].type) return false;
+
+      if (u_int(slot) != i)
+      {
+        std::swap(keys_[i], keys_[slot]);
+        std::swap(values_[i], values_[slot]);
+      }
+    }
+    return true;
+  }
+
+
+  u_int size() const noexcept
+  {
+    return u_int(keys_.size());
+  }
+
+  const Atom& key(const u_int slot) const noexcept
+  {
+    return keys_[slot];
+  }
+
+};
+
+} }
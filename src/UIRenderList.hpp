@@ -0,0 +1,518 @@
+﻿#pragma once
+
+//
+// 描画内容の記録
+//   UI::CanvasがWidgetごとに描画関数の出力(頂点・シェーダー・テクスチャ・色)を記録しておき、
+//   変化が無いフレームは記録したものをそのまま描画する
+//   変わったWidgetは区間だけ書き換える。命令の数や並びが変わる時は全部記録し直す
+//   頂点は {位置, UV, 色(RGBA8)} を詰めて並べる
+//   角丸矩形は一つを頂点二つ分の領域に詰める(UI::Drawerがインスタンスの値として読む)
+//   内容が変わると版が上がる(UI::Drawerがレイヤーを描き直すのに使う)
+//   TIPS:OpenGLは使わない(転送と描画はUI::Drawerが行う)
+//
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <boost/noncopyable.hpp>
+#include "UIPropertyBlock.hpp"
+
+
+namespace ngs { namespace UI {
+
+class Widget;
+
+class RenderList
+  : private boost::noncopyable
+{
+public:
+  struct Vertex
+  {
+    ci::vec2 pos;
+    ci::vec2 uv;
+    uint32_t color;
+  };
+
+  // 角丸矩形
+  //   TIPS:比較はmemcmpで行うので余りも0で埋めておく
+  struct Rounded
+  {
+    ci::Rectf rect;
+    uint32_t color;
+    float corner_radius;
+    float line_width;           // 0なら塗り潰し
+    float reserved[3];
+  };
+  static_assert(sizeof(Rounded) == (sizeof(Vertex) * 2), "Rounded must fit in two vertices.");
+
+  // 頂点にできないものは描画時に関数を呼ぶ
+  using Callback = void (*)(void* context, const Widget& widget, const ci::Rectf& rect, const ci::vec2& scale);
+
+  // 描画命令
+  //   callbackがnullptrなら頂点[first, first + count)を三角形で描画
+  //   layerがあれば、その描画結果をテクスチャとして頂点に貼る
+  struct Command
+  {
+    u_int shader = 0;
+    TextureRef texture;
+    u_int first = 0;
+    u_int count = 0;
+
+    Callback callback = nullptr;
+    void* context = nullptr;
+    const Widget* widget = nullptr;
+    ci::Rectf rect;
+    ci::vec2 scale;
+
+    const RenderList* layer = nullptr;
+
+
+    // まとめて描画できない
+    bool isSpecial() const noexcept
+    {
+      return callback || layer;
+    }
+  };
+
+  // 実際に描画する単位
+  //   TIPS:頂点が続いていて、シェーダーとテクスチャが同じ命令はまとめる
+  //        塗り潰しはUI::TextureAtlasの白いテクセルを貼って画像と同じ命令にする
+  struct Run
+  {
+    u_int command;
+    u_int first;
+    u_int count;
+  };
+
+
+private:
+  std::vector<Vertex> vertices_;
+  std::vector<Command> commands_;
+  std::vector<Run> runs_;
+
+  // Widget(UI::Layout上の番号)ごとの命令の区間
+  struct Span
+  {
+    u_int first = 0;
+    u_int num   = 0;
+  };
+  std::vector<Span> spans_;
+
+  // 前回記録した内容(変わったかどうかの比較用)
+  std::vector<Vertex> prev_vertices_;
+  std::vector<Command> prev_commands_;
+
+  // 識別番号と版
+  //   TIPS:識別番号はインスタンスごとに違う
+  u_int id_;
+  u_int version_ = 0;
+
+  // 記録中のWidgetの出力
+  //   TIPS:頂点の位置はpending_vertices_の先頭から数える
+  std::vector<Vertex> pending_vertices_;
+  std::vector<Command> pending_;
+
+  // 転送が必要な頂点の範囲
+  bool upload_all_   = true;
+  u_int upload_begin_ = 0;
+  u_int upload_end_   = 0;
+
+  bool record_requested_ = false;
+
+  // このフレームで記録した命令の数
+  u_int recorded_num_ = 0;
+
+
+  // 命令を続けるか新しく始める
+  Command& command(const u_int shader, const TextureRef& texture) noexcept
+  {
+    if (pending_.empty()
+        || pending_.back().isSpecial()
+        || (pending_.back().shader != shader)
+        || (pending_.back().texture != texture))
+    {
+      Command command;
+      command.shader  = shader;
+      command.texture = texture;
+      command.first   = u_int(pending_vertices_.size());
+      pending_.push_back(command);
+    }
+    return pending_.back();
+  }
+
+  static bool isSameShape(const Command& a, const Command& b) noexcept
+  {
+    return (a.shader == b.shader) && (a.texture == b.texture) && (a.count == b.count)
+        && (a.callback == b.callback) && (a.context == b.context) && (a.widget == b.widget)
+        && (a.layer == b.layer);
+  }
+
+  static bool isSameRect(const ci::Rectf& a, const ci::Rectf& b) noexcept
+  {
+    return (a.x1 == b.x1) && (a.y1 == b.y1) && (a.x2 == b.x2) && (a.y2 == b.y2);
+  }
+
+  // 描画結果が同じになるか
+  //   TIPS:関数を呼ぶ命令はWidgetの状態を直接読むので、同じとはみなさない
+  static bool isSameCommand(const Command& a, const Command& b) noexcept
+  {
+    return !a.callback && isSameShape(a, b) && (a.first == b.first)
+        && isSameRect(a.rect, b.rect) && (a.scale == b.scale);
+  }
+
+  static bool isSameVertices(const Vertex* a, const Vertex* b, const u_int num) noexcept
+  {
+    return !num || !std::memcmp(a, b, num * sizeof(Vertex));
+  }
+
+  static u_int newId() noexcept
+  {
+    static std::atomic<u_int> id(0);
+    return ++id;
+  }
+
+
+public:
+  RenderList() noexcept
+    : id_(newId())
+  {}
+
+
+  static uint32_t packColor(const ci::ColorA& color) noexcept
+  {
+    auto c8 = [](const float v) noexcept {
+      return uint32_t(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+    };
+
+    return c8(color.r) | (c8(color.g) << 8) | (c8(color.b) << 16) | (c8(color.a) << 24);
+  }
+
+
+  // 以下、描画関数から使う
+
+  // 四角形を追加
+  //   rectの(x1, y1)にuvの(x1, y1)が対応する
+  void add(const u_int shader, const TextureRef& texture,
+           const ci::Rectf& rect, const ci::Rectf& uv, const uint32_t color) noexcept
+  {
+    auto& c = command(shader, texture);
+
+    pending_vertices_.push_back({ ci::vec2(rect.x1, rect.y1), ci::vec2(uv.x1, uv.y1), color });
+    pending_vertices_.push_back({ ci::vec2(rect.x2, rect.y1), ci::vec2(uv.x2, uv.y1), color });
+    pending_vertices_.push_back({ ci::vec2(rect.x2, rect.y2), ci::vec2(uv.x2, uv.y2), color });
+
+    pending_vertices_.push_back({ ci::vec2(rect.x1, rect.y1), ci::vec2(uv.x1, uv.y1), color });
+    pending_vertices_.push_back({ ci::vec2(rect.x2, rect.y2), ci::vec2(uv.x2, uv.y2), color });
+    pending_vertices_.push_back({ ci::vec2(rect.x1, rect.y2), ci::vec2(uv.x1, uv.y2), color });
+
+    c.count += 6;
+  }
+
+  // 枠(四辺を四角形で)
+  //   TIPS:線は辺の中心に引く
+  //   uvは四辺すべてに貼る
+  void addStroked(const u_int shader, const TextureRef& texture, const ci::Rectf& rect, const float line_width,
+                  const ci::Rectf& uv, const uint32_t color) noexcept
+  {
+    float w = line_width / 2.0f;
+
+    add(shader, texture, ci::Rectf(rect.x1 - w, rect.y1 - w, rect.x2 + w, rect.y1 + w), uv, color);
+    add(shader, texture, ci::Rectf(rect.x1 - w, rect.y2 - w, rect.x2 + w, rect.y2 + w), uv, color);
+    add(shader, texture, ci::Rectf(rect.x1 - w, rect.y1 + w, rect.x1 + w, rect.y2 - w), uv, color);
+    add(shader, texture, ci::Rectf(rect.x2 - w, rect.y1 + w, rect.x2 + w, rect.y2 - w), uv, color);
+  }
+
+  // 角丸矩形を追加
+  //   TIPS:線は辺の中心に引く
+  void addRounded(const u_int shader, const ci::Rectf& rect, const float corner_radius, const float line_width,
+                  const uint32_t color) noexcept
+  {
+    auto& c = command(shader, TextureRef());
+
+    Rounded rounded = { rect, color, corner_radius, line_width, { 0.0f, 0.0f, 0.0f } };
+    size_t first = pending_vertices_.size();
+    pending_vertices_.resize(first + 2);
+    std::memcpy(static_cast<void*>(&pending_vertices_[first]), &rounded, sizeof(rounded));
+
+    c.count += 2;
+  }
+
+  // 三角形の頂点を追加(文字列など)
+  void addVertices(const u_int shader, const TextureRef& texture,
+                   const Vertex* vertices, const u_int num) noexcept
+  {
+    if (!num) return;
+
+    auto& c = command(shader, texture);
+    pending_vertices_.insert(std::end(pending_vertices_), vertices, vertices + num);
+    c.count += num;
+  }
+
+  // 別の記録の描画結果を四角形に貼る
+  //   TIPS:UVは(0, 0)-(1, 1)
+  void addLayer(const RenderList& layer, const ci::Rectf& rect) noexcept
+  {
+    Command command;
+    command.first = u_int(pending_vertices_.size());
+    command.rect  = rect;
+    command.layer = &layer;
+    pending_.push_back(command);
+
+    ci::Rectf uv(0, 0, 1, 1);
+    uint32_t color = 0xffffffff;
+    pending_vertices_.push_back({ ci::vec2(rect.x1, rect.y1), ci::vec2(uv.x1, uv.y1), color });
+    pending_vertices_.push_back({ ci::vec2(rect.x2, rect.y1), ci::vec2(uv.x2, uv.y1), color });
+    pending_vertices_.push_back({ ci::vec2(rect.x2, rect.y2), ci::vec2(uv.x2, uv.y2), color });
+
+    pending_vertices_.push_back({ ci::vec2(rect.x1, rect.y1), ci::vec2(uv.x1, uv.y1), color });
+    pending_vertices_.push_back({ ci::vec2(rect.x2, rect.y2), ci::vec2(uv.x2, uv.y2), color });
+    pending_vertices_.push_back({ ci::vec2(rect.x1, rect.y2), ci::vec2(uv.x1, uv.y2), color });
+
+    pending_.back().count = 6;
+  }
+
+  // 描画時に関数を呼ぶ
+  void addCallback(const Callback callback, void* context,
+                   const Widget& widget, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  {
+    Command command;
+    command.first    = u_int(pending_vertices_.size());
+    command.callback = callback;
+    command.context  = context;
+    command.widget   = &widget;
+    command.rect     = rect;
+    command.scale    = scale;
+    pending_.push_back(command);
+  }
+
+  // 記録し直しを頼む
+  //   TIPS:フォントのテクスチャが作り直された時など、記録済みの内容が使えなくなった時
+  void requestRecord() noexcept
+  {
+    record_requested_ = true;
+  }
+
+
+  // 以下、UI::Canvasから使う
+
+  // 全部記録し直す
+  //   num: Widgetの数
+  void begin(const u_int num) noexcept
+  {
+    prev_vertices_.swap(vertices_);
+    prev_commands_.swap(commands_);
+    vertices_.clear();
+    commands_.clear();
+    runs_.clear();
+    // TIPS:描画しないWidgetの区間は使わないので消さなくてよい
+    spans_.resize(num);
+
+    record_requested_ = false;
+    recorded_num_ = 0;
+  }
+
+  // Widget一つ分の記録を始める
+  void beginWidget() noexcept
+  {
+    pending_vertices_.clear();
+    pending_.clear();
+  }
+
+  // 記録をindex番目のWidgetの区間として追加
+  void endWidget(const u_int index) noexcept
+  {
+    assert(index < spans_.size());
+
+    u_int offset = u_int(vertices_.size());
+    spans_[index] = { u_int(commands_.size()), u_int(pending_.size()) };
+    for (auto command : pending_)
+    {
+      command.first += offset;
+      commands_.push_back(command);
+    }
+    vertices_.insert(std::end(vertices_), std::begin(pending_vertices_), std::end(pending_vertices_));
+
+    recorded_num_ += u_int(pending_.size());
+  }
+
+  // 全部記録し終わった
+  void end() noexcept
+  {
+    for (u_int i = 0; i < commands_.size(); ++i)
+    {
+      const auto& command = commands_[i];
+      if (!command.isSpecial() && !command.count) continue;
+
+      if (!command.isSpecial() && !runs_.empty())
+      {
+        auto& run = runs_.back();
+        const auto& prev = commands_[run.command];
+        if (!prev.isSpecial()
+            && (prev.shader == command.shader) && (prev.texture == command.texture)
+            && ((run.first + run.count) == command.first))
+        {
+          run.count += command.count;
+          continue;
+        }
+      }
+      runs_.push_back({ i, command.first, command.count });
+    }
+
+    upload_all_ = true;
+
+    // 前回と同じ内容なら版は変えない
+    bool same = (vertices_.size() == prev_vertices_.size())
+             && (commands_.size() == prev_commands_.size())
+             && isSameVertices(vertices_.data(), prev_vertices_.data(), u_int(vertices_.size()));
+    for (u_int i = 0; same && (i < commands_.size()); ++i)
+    {
+      same = isSameCommand(commands_[i], prev_commands_[i]);
+    }
+    if (!same) version_ += 1;
+  }
+
+  // index番目のWidgetの区間を記録で置き換える
+  //   命令の数や並びが違う時は何もしないでfalseを返す
+  bool replaceWidget(const u_int index) noexcept
+  {
+    if (index >= spans_.size()) return false;
+
+    const auto& span = spans_[index];
+    if (span.num != pending_.size()) return false;
+    for (u_int i = 0; i < span.num; ++i)
+    {
+      if (!isSameShape(commands_[span.first + i], pending_[i])) return false;
+    }
+
+    bool changed = false;
+    for (u_int i = 0; i < span.num; ++i)
+    {
+      auto& command = commands_[span.first + i];
+      const auto& src = pending_[i];
+      if (command.callback || !isSameRect(command.rect, src.rect) || (command.scale != src.scale))
+      {
+        command.rect  = src.rect;
+        command.scale = src.scale;
+        changed = true;
+      }
+      // TIPS:同じ頂点なら転送しない
+      if (!command.count
+          || isSameVertices(&vertices_[command.first], &pending_vertices_[src.first], command.count))
+      {
+        continue;
+      }
+      changed = true;
+
+      std::copy(std::begin(pending_vertices_) + src.first, std::begin(pending_vertices_) + src.first + src.count,
+                std::begin(vertices_) + command.first);
+
+      if (upload_begin_ == upload_end_)
+      {
+        upload_begin_ = command.first;
+        upload_end_   = command.first + command.count;
+      }
+      else
+      {
+        upload_begin_ = std::min(upload_begin_, command.first);
+        upload_end_   = std::max(upload_end_, command.first + command.count);
+      }
+    }
+
+    if (changed) version_ += 1;
+    recorded_num_ += span.num;
+    return true;
+  }
+
+  bool isRecordRequested() const noexcept
+  {
+    return record_requested_;
+  }
+
+  // フレームの始めに数を戻す
+  void resetRecordedNum() noexcept
+  {
+    recorded_num_ = 0;
+  }
+
+
+  // 以下、UI::Drawerから使う
+  const std::vector<Vertex>& getVertices() const noexcept
+  {
+    return vertices_;
+  }
+
+  const std::vector<Run>& getRuns() const noexcept
+  {
+    return runs_;
+  }
+
+  const Command& getCommand(const u_int index) const noexcept
+  {
+    return commands_[index];
+  }
+
+  // 転送が必要な頂点
+  //   TIPS:全部記録し直した時は全体
+  bool isUploadAll() const noexcept
+  {
+    return upload_all_;
+  }
+
+  u_int getUploadBegin() const noexcept
+  {
+    return upload_begin_;
+  }
+
+  u_int getUploadEnd() const noexcept
+  {
+    return upload_end_;
+  }
+
+  void clearUpload() noexcept
+  {
+    upload_all_   = false;
+    upload_begin_ = 0;
+    upload_end_   = 0;
+  }
+
+
+  u_int getId() const noexcept
+  {
+    return id_;
+  }
+
+  // 内容が変わるたびに上がる
+  u_int getVersion() const noexcept
+  {
+    return version_;
+  }
+
+  // 記録した命令の数
+  u_int getCommandNum() const noexcept
+  {
+    return u_int(commands_.size());
+  }
+
+  // このフレームで記録した命令の数
+  u_int getRecordedNum() const noexcept
+  {
+    return recorded_num_;
+  }
+
+  // このフレームで記録せずに使い回した命令の数
+  //   TIPS:同じ区間を二度書き換えた時は記録した方が多くなる
+  u_int getReplayedNum() const noexcept
+  {
+    return u_int(commands_.size()) - std::min(recorded_num_, u_int(commands_.size()));
+  }
+
+  bool empty() const noexcept
+  {
+    return runs_.empty();
+  }
+
+};
+
+} }
@@ -0,0 +1,195 @@
+﻿#pragma once
+
+//
+// UI用の画像をまとめたテクスチャ
+//   小さな画像は大きなテクスチャ(ページ)に詰め込み、UV座標で参照する
+//   詰め込みはfontstashのスカイライン法を使う
+//   大きな画像は単独のテクスチャにする
+//   TIPS:同じパスの画像は一度だけ読み込む
+//
+
+#include <map>
+#include <memory>
+#include <boost/noncopyable.hpp>
+#include <cinder/ImageIo.h>
+#include <cinder/Surface.h>
+#include "fontstash.h"
+#include "UIPropertyBlock.hpp"
+
+
+namespace ngs { namespace UI {
+
+class TextureAtlas
+  : private boost::noncopyable
+{
+  struct Page
+  {
+    std::unique_ptr<FONSatlas, void (*)(FONSatlas*)> packer;
+    ci::gl::Texture2dRef texture;
+    // 詰め込んだ画像の面積
+    size_t used;
+
+    Page(const int size) noexcept
+      : packer(fonsCreateAtlas(size, size, 256), fonsDeleteAtlas),
+        texture(ci::gl::Texture2d::create(size, size,
+                                          ci::gl::Texture2d::Format().internalFormat(GL_RGBA8))),
+        used(0)
+    {}
+  };
+
+  int page_size_;
+  // これより大きな画像は単独のテクスチャ
+  int max_image_size_;
+
+  std::vector<std::unique_ptr<Page>> pages_;
+  u_int standalone_num_ = 0;
+
+  std::map<std::string, AtlasImage> images_;
+
+  // 白一色の場所(UVは一点)
+  AtlasImage white_;
+
+
+  // 周囲1ピクセルに端の色を複製した画像
+  // TIPS:線形補間で隣の画像の色が混ざらないようにする
+  static ci::Surface8u extrude(const ci::Surface8u& surface) noexcept
+  {
+    int w = surface.getWidth();
+    int h = surface.getHeight();
+
+    ci::Surface8u result(w + 2, h + 2, true, ci::SurfaceChannelOrder::RGBA);
+    for (int y = 0; y < h + 2; ++y)
+    {
+      int sy = std::min(std::max(y - 1, 0), h - 1);
+      for (int x = 0; x < w + 2; ++x)
+      {
+        int sx = std::min(std::max(x - 1, 0), w - 1);
+        result.setPixel(ci::ivec2(x, y), surface.getPixel(ci::ivec2(sx, sy)));
+      }
+    }
+    return result;
+  }
+
+  // ページに詰め込む
+  //   入らなければページを追加
+  AtlasImage pack(const ci::Surface8u& surface) noexcept
+  {
+    auto padded = extrude(surface);
+    int w = padded.getWidth();
+    int h = padded.getHeight();
+
+    int x, y;
+    Page* page = nullptr;
+    for (auto& p : pages_)
+    {
+      if (fonsAtlasAddRect(p->packer.get(), w, h, &x, &y))
+      {
+        page = p.get();
+        break;
+      }
+    }
+    if (!page)
+    {
+      pages_.emplace_back(new Page(page_size_));
+      page = pages_.back().get();
+      int result = fonsAtlasAddRect(page->packer.get(), w, h, &x, &y);
+      assert(result);
+    }
+
+    // TIPS:Fontが転送範囲の指定を書き換えているので戻しておく
+    glPixelStorei(GL_UNPACK_ROW_LENGTH,  int(padded.getRowBytes() / 4));
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS,   0);
+    page->texture->update(padded.getData(), GL_RGBA, GL_UNSIGNED_BYTE, 0, w, h, ci::ivec2(x, y));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH,  0);
+
+    page->used += size_t(surface.getWidth()) * surface.getHeight();
+
+    float size = float(page_size_);
+    ci::Rectf uv((x + 1) / size, (y + 1) / size,
+                 (x + w - 1) / size, (y + h - 1) / size);
+    return { page->texture, uv };
+  }
+
+
+public:
+  TextureAtlas(const int page_size = 1024, const int max_image_size = 256) noexcept
+    : page_size_(page_size),
+      max_image_size_(max_image_size)
+  {}
+
+
+  // 白一色の場所
+  //   一色塗り潰しもこのテクセルを貼って画像と同じシェーダー・テクスチャで描き、描画をまとめる
+  //   TIPS:UVは白い範囲の中心の一点なので、線形補間しても白のまま
+  //        最初に呼べば先頭のページに入る
+  const AtlasImage& white() noexcept
+  {
+    if (!white_.texture)
+    {
+      ci::Surface8u surface(2, 2, true, ci::SurfaceChannelOrder::RGBA);
+      for (int y = 0; y < 2; ++y)
+      {
+        for (int x = 0; x < 2; ++x)
+        {
+          surface.setPixel(ci::ivec2(x, y), ci::ColorA8u(255, 255, 255, 255));
+        }
+      }
+
+      auto image = pack(surface);
+      ci::vec2 center = image.uv.getCenter();
+      white_ = { image.texture, ci::Rectf(center, center) };
+    }
+    return white_;
+  }
+
+  // 画像を読み込む
+  AtlasImage load(const std::string& path) noexcept
+  {
+    auto it = images_.find(path);
+    if (it != std::end(images_)) return it->second;
+
+    ci::Surface8u surface(ci::loadImage(Asset::load(path)));
+
+    AtlasImage image;
+    if ((surface.getWidth() > max_image_size_) || (surface.getHeight() > max_image_size_))
+    {
+      image = { ci::gl::Texture2d::create(surface), ci::Rectf(0, 0, 1, 1) };
+      standalone_num_ += 1;
+    }
+    else
+    {
+      image = pack(surface);
+    }
+
+    images_.insert({ path, image });
+    return image;
+  }
+
+
+  u_int getPageNum() const noexcept
+  {
+    return u_int(pages_.size());
+  }
+
+  u_int getStandaloneNum() const noexcept
+  {
+    return standalone_num_;
+  }
+
+  // ページ全体のうち画像が占める割合
+  float getFillRate() const noexcept
+  {
+    if (pages_.empty()) return 0.0f;
+
+    size_t used = 0;
+    for (const auto& page : pages_)
+    {
+      used += page->used;
+    }
+    return float(used) / (float(page_size_) * page_size_ * pages_.size());
+  }
+
+};
+
+} }
@@ -0,0 +1,277 @@
+﻿#pragma once
+
+//
+// タッチ判定用の空間分割
+//   Canvasを格子に区切って、タッチ可能なWidgetだけを登録しておく
+//   タッチ位置の升目にいるWidgetだけを調べればよい
+//   タッチ可能かどうかが変わった時は、その部分木だけ登録し直す(refresh)
+//   TIPS:番号はUI::Layoutの深さ優先順
+//
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "UILayout.hpp"
+
+
+namespace ngs { namespace UI {
+
+class TouchIndex
+{
+  // 登録した升目の範囲
+  struct Entry
+  {
+    bool registered = false;
+    // 自分と先祖が全部表示されている
+    //   TIPS:rebuildで飛ばした部分木はfalseのまま(refreshで調べ直す)
+    bool visible = false;
+
+    u_int x1, y1;
+    u_int x2, y2;
+  };
+
+  std::vector<Entry> entries_;
+  // 登録したWidget
+  std::vector<u_int> registered_;
+  u_int registered_num_ = 0;
+
+  // 升目ごとに登録されているWidget(深さ優先順に並べておく)
+  std::vector<std::vector<u_int>> cells_;
+
+  ci::Rectf bounds_;
+  u_int division_ = 1;
+  ci::vec2 cell_scale_;
+
+
+  // TIPS:範囲外(NaNも)は端の升目
+  u_int cell(const float v) const noexcept
+  {
+    if (!(v > 0.0f)) return 0;
+    if (v >= float(division_)) return division_ - 1;
+    return u_int(v);
+  }
+
+  u_int cellX(const float x) const noexcept
+  {
+    return cell((x - bounds_.x1) * cell_scale_.x);
+  }
+
+  u_int cellY(const float y) const noexcept
+  {
+    return cell((y - bounds_.y1) * cell_scale_.y);
+  }
+
+  // TIPS:Canvasからはみ出す部分は端の升目に入れる
+  void setCellRange(Entry& entry, const ci::Rectf& rect) const noexcept
+  {
+    entry.x1 = cellX(std::min(rect.x1, rect.x2));
+    entry.x2 = cellX(std::max(rect.x1, rect.x2));
+    entry.y1 = cellY(std::min(rect.y1, rect.y2));
+    entry.y2 = cellY(std::max(rect.y1, rect.y2));
+  }
+
+  void insert(const u_int position, const Entry& entry) noexcept
+  {
+    for (u_int y = entry.y1; y <= entry.y2; ++y)
+    {
+      for (u_int x = entry.x1; x <= entry.x2; ++x)
+      {
+        auto& cell = cells_[y * division_ + x];
+        cell.insert(std::lower_bound(std::begin(cell), std::end(cell), position), position);
+      }
+    }
+  }
+
+  void remove(const u_int position, const Entry& entry) noexcept
+  {
+    for (u_int y = entry.y1; y <= entry.y2; ++y)
+    {
+      for (u_int x = entry.x1; x <= entry.x2; ++x)
+      {
+        auto& cell = cells_[y * division_ + x];
+        auto it = std::lower_bound(std::begin(cell), std::end(cell), position);
+        if ((it != std::end(cell)) && (*it == position))
+        {
+          cell.erase(it);
+        }
+      }
+    }
+  }
+
+  bool isParentVisible(const Layout& layout, const u_int position) const noexcept
+  {
+    if (position == 0) return true;
+
+    return entries_[layout.widget(position)->getParent()->getLayoutIndex()].visible;
+  }
+
+  void setRegistered(const Layout& layout, const u_int position, const bool registered) noexcept
+  {
+    auto& entry = entries_[position];
+    if (entry.registered == registered) return;
+
+    entry.registered = registered;
+    if (registered)
+    {
+      setCellRange(entry, layout.worldRect(position));
+      insert(position, entry);
+      registered_num_ += 1;
+    }
+    else
+    {
+      remove(position, entry);
+      registered_num_ -= 1;
+    }
+  }
+
+  // 部分木[begin, end)を全部調べ直す
+  void refreshSubtree(const Layout& layout, const u_int begin, const u_int end) noexcept
+  {
+    for (u_int i = begin; i < end; ++i)
+    {
+      auto* widget = layout.widget(i);
+      widget->clearInputChanged();
+
+      bool visible = isParentVisible(layout, i) && widget->isDisplay();
+      entries_[i].visible = visible;
+      setRegistered(layout, i, visible && widget->isActive() && widget->isTouchEvent());
+    }
+  }
+
+
+public:
+  TouchIndex() = default;
+
+
+  // 全部登録し直す
+  //   bounds: Canvasの範囲
+  void rebuild(const Layout& layout, const ci::Rectf& bounds) noexcept
+  {
+    u_int num = layout.size();
+    entries_.assign(num, Entry());
+
+    // 変更の印を消す
+    // TIPS:印はrootまで付いているので、印の無い部分木は飛ばせる
+    u_int position = 0;
+    while (position < num)
+    {
+      auto* widget = layout.widget(position);
+      if (!widget->isInputChanged())
+      {
+        position = layout.subtreeEnd(position);
+        continue;
+      }
+
+      widget->clearInputChanged();
+      position += 1;
+    }
+
+    // タッチ可能なWidgetを調べる
+    // TIPS:非表示のWidgetの子供もタッチできない
+    //      タッチ可能なWidgetがいない部分木は飛ばす
+    registered_.clear();
+    position = 0;
+    while (position < num)
+    {
+      auto* widget = layout.widget(position);
+      if (!widget->isDisplay() || !widget->hasTouchable())
+      {
+        position = layout.subtreeEnd(position);
+        continue;
+      }
+
+      entries_[position].visible = true;
+      if (widget->isActive() && widget->isTouchEvent())
+      {
+        entries_[position].registered = true;
+        registered_.push_back(position);
+      }
+      position += 1;
+    }
+    u_int touchable_num = u_int(registered_.size());
+    registered_num_ = touchable_num;
+
+    // 一升に4つくらい入る分割数
+    bounds_   = bounds;
+    division_ = std::min(std::max(u_int(std::sqrt(touchable_num / 4.0f)), 1u), 64u);
+    cell_scale_ = ci::vec2(division_) / bounds_.getSize();
+
+    cells_.resize(division_ * division_);
+    for (auto& cell : cells_)
+    {
+      cell.clear();
+    }
+
+    for (auto i : registered_)
+    {
+      auto& entry = entries_[i];
+      setCellRange(entry, layout.worldRect(i));
+      insert(i, entry);
+    }
+  }
+
+  // タッチ可能かどうかが変わったWidgetを登録し直す
+  //   変更の印を辿り、表示が変わったWidgetは部分木ごと調べ直す
+  //   TIPS:登録数が増えて升目が混んできたらfalse(rebuildし直すこと)
+  bool refresh(const Layout& layout) noexcept
+  {
+    u_int num = layout.size();
+    u_int position = 0;
+    while (position < num)
+    {
+      auto* widget = layout.widget(position);
+      if (!widget->isInputChanged())
+      {
+        position = layout.subtreeEnd(position);
+        continue;
+      }
+
+      // TIPS:印は先祖にも付いているので、親は調べ直してある
+      bool visible = isParentVisible(layout, position) && widget->isDisplay();
+      if (visible != entries_[position].visible)
+      {
+        u_int end = layout.subtreeEnd(position);
+        refreshSubtree(layout, position, end);
+        position = end;
+        continue;
+      }
+
+      widget->clearInputChanged();
+      setRegistered(layout, position, visible && widget->isActive() && widget->isTouchEvent());
+      position += 1;
+    }
+
+    // TIPS:rebuildでは一升に4つくらいになるよう分割している
+    return (division_ == 64) || (registered_num_ <= division_ * division_ * 16);
+  }
+
+  // [begin, end)の位置が変わった
+  void update(const Layout& layout, const u_int begin, const u_int end) noexcept
+  {
+    for (u_int i = begin; i < end; ++i)
+    {
+      auto& entry = entries_[i];
+      if (!entry.registered) continue;
+
+      Entry moved = entry;
+      setCellRange(moved, layout.worldRect(i));
+      if ((moved.x1 == entry.x1) && (moved.y1 == entry.y1)
+          && (moved.x2 == entry.x2) && (moved.y2 == entry.y2)) continue;
+
+      remove(i, entry);
+      insert(i, moved);
+      entry = moved;
+    }
+  }
+
+  // posを含むかもしれないWidgetを深さ優先順に列挙
+  // TIPS:矩形の判定は呼び出し側で行う
+  void query(const ci::vec2& pos, std::vector<u_int>& result) const noexcept
+  {
+    const auto& cell = cells_[cellY(pos.y) * division_ + cellX(pos.x)];
+    result.assign(std::begin(cell), std::end(cell));
+  }
+
+};
+
+} }
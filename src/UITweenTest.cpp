@@ -0,0 +1,124 @@
+﻿//
+// 再生中のTweenとWidgetの破棄のテスト
+//   破棄したWidgetの値(と、その場所を再利用したWidget)をタイムラインが書き換えないか調べる
+//   失敗したら1で終了
+//
+
+#include <iostream>
+#include <iomanip>
+#include <cinder/Timeline.h>
+
+#include "Defines.hpp"
+#include "Params.hpp"
+#include "JsonUtil.hpp"
+#include "UICanvas.hpp"
+#include "UINullDrawer.hpp"
+#include "TweenHandler.hpp"
+
+
+namespace ngs {
+
+bool report(const std::string& name, const bool result) noexcept
+{
+  std::cout << std::left << std::setw(40) << name << (result ? "ok" : "FAILED") << std::endl;
+  return result;
+}
+
+
+struct Fixture
+{
+  UI::NullDrawer drawer;
+  UI::Canvas canvas = UI::Canvas(ci::vec2(1024, 768));
+  UI::WidgetQueryPtr widgets = std::make_shared<UI::WidgetQuery>();
+  UI::Widget* root;
+
+  Fixture() noexcept
+  {
+    root = create("root", nullptr);
+    canvas.setWidgets(root);
+  }
+
+  UI::Widget* create(const std::string& identifier, UI::Widget* parent) noexcept
+  {
+    auto* widget = canvas.getArena().create(identifier, ci::Rectf(-10.0f, -10.0f, 10.0f, 10.0f),
+                                            widgets, drawer.getFunc("blank"));
+    if (parent) parent->addChild(widget);
+    return widget;
+  }
+};
+
+
+// 再生中に破棄して、同じ場所に別のWidgetを作る
+bool testDestroyWhileRunning() noexcept
+{
+  Fixture f;
+  auto* button = f.create("button", f.root);
+
+  auto timeline = ci::Timeline::create();
+  TweenHandler handler(Params::load("tween_began.json"));
+  handler.start(timeline, button);
+  timeline->step(0.1);
+
+  bool result = (timeline->getNumItems() > 0) && (button->getScale().x != 1.0f);
+
+  f.canvas.destroyWidget(button);
+  result = (timeline->getNumItems() == 0) && result;
+
+  // TIPS:破棄した場所が再利用される
+  auto* reused = f.create("reused", f.root);
+  result = (reused == button) && result;
+
+  reused->setScale(ci::vec2(1.0f));
+  timeline->step(0.1);
+  result = (reused->getScale() == ci::vec2(1.0f)) && result;
+
+  return report("tween: destroy while running", result);
+}
+
+// 親を破棄すると子供のTweenも取り除かれる
+bool testDestroyParent() noexcept
+{
+  Fixture f;
+  auto* panel  = f.create("panel", f.root);
+  auto* button = f.create("button", panel);
+
+  auto timeline = ci::Timeline::create();
+  TweenHandler handler(Params::load("tween_began.json"));
+  handler.start(timeline, button);
+  handler.start(timeline, panel);
+  timeline->step(0.1);
+
+  bool result = timeline->getNumItems() > 0;
+  f.canvas.destroyWidget(panel);
+  result = (timeline->getNumItems() == 0) && result;
+
+  return report("tween: destroy parent", result);
+}
+
+// 破棄されたタイムラインは気にしない
+bool testTimelineExpired() noexcept
+{
+  Fixture f;
+  auto* button = f.create("button", f.root);
+
+  auto timeline = ci::Timeline::create();
+  TweenHandler handler(Params::load("tween_began.json"));
+  handler.start(timeline, button);
+  timeline.reset();
+
+  f.canvas.destroyWidget(button);
+  return report("tween: timeline released first", true);
+}
+
+}
+
+
+int main()
+{
+  bool result = ngs::testDestroyWhileRunning();
+  result = ngs::testDestroyParent() && result;
+  result = ngs::testTimelineExpired() && result;
+
+  std::cout << (result ? "passed" : "FAILED") << std::endl;
+  return result ? 0 : 1;
+}
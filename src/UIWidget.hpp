@@ -2,30 +2,51 @@
 
 //
 // UI部品
-//  TODO:WidgetのRectの計算量を減らす
 //
 
+#include <algorithm>
+#include <unordered_map>
 #include <boost/noncopyable.hpp>
-#include <boost/any.hpp>
 #include <boost/optional.hpp>
+#include <cinder/Timeline.h>
 #include "Touch.hpp"
-#include "Event.hpp"
-#include "Misc.hpp"
+#include "Delegate.hpp"
+#include "UIPropertyBlock.hpp"
+#include "UIWidgetQuery.hpp"
+#include "UIDrawFunc.hpp"
 
 
 namespace ngs { namespace UI {
 
 // TIPS:自分自身を引数に取る関数があるので先行宣言が必要
 class Widget;
-using WidgetPtr = std::shared_ptr<Widget>;
+
+// UI::WidgetArena上の番号と世代
+//   TIPS:破棄されると世代が変わるので、古いハンドルからは引けない
+struct WidgetHandle
+{
+  u_int index      = 0;
+  u_int generation = 0;           // 0は無効
+
+  bool isValid() const noexcept
+  {
+    return generation != 0;
+  }
+
+  bool operator==(const WidgetHandle& rhs) const noexcept
+  {
+    return (index == rhs.index) && (generation == rhs.generation);
+  }
+
+  bool operator!=(const WidgetHandle& rhs) const noexcept
+  {
+    return !(*this == rhs);
+  }
+};
 
 // クエリ用コンテナ
-using WidgetQuery    = std::map<std::string, Widget*>;
 using WidgetQueryPtr = std::shared_ptr<WidgetQuery>;
 
-// 描画用関数
-using DrawFunc = std::function<void (const Widget&, const ci::Rectf& rect, const ci::vec2& scale)>;
-
 
 class Widget
   : private boost::noncopyable
@@ -45,10 +66,21 @@ public:
     CANCELED,            // タッチイベント中断
   };
 
+  // Tweenで書き換えられる値
+  enum Param {
+    RECT_X1, RECT_X2, RECT_Y1, RECT_Y2,
+    PIVOT_X, PIVOT_Y,
+    ANCHOR_MIN_X, ANCHOR_MIN_Y, ANCHOR_MAX_X, ANCHOR_MAX_Y,
+    SCALE_X, SCALE_Y,
+    COLOR_R, COLOR_G, COLOR_B, COLOR_A,
+
+    PARAM_NUM
+  };
+
 
 private:
-  std::string identifier_;
-  std::string type_;
+  Atom identifier_;
+  Atom type_;
 
   ci::Rectf rect_;
 
@@ -64,19 +96,66 @@ private:
   ci::ColorA color_ = { 1.0f, 1.0f, 1.0f, 1.0f };
 
 
+  // 親子関係(Rectの再計算を伝えるのに使う)
+  Widget* parent_ = nullptr;
+
+  // UI::Layout上の番号
+  u_int layout_index_ = 0;
+
+  // Rectの再計算が必要
+  bool layout_dirty_  = true;
+  // 子孫にRectの再計算が必要なWidgetがいる
+  bool subtree_dirty_ = false;
+
+  // TIPS:ポインタ経由で値を書き換えられる(Tween、Editor)と
+  //      変更を検出できないので、前回計算時の値と比較する
+  bool layout_watched_  = false;
+  bool subtree_watched_ = false;
+
+  // 子孫の追加などで階層が変わった
+  bool tree_changed_ = true;
+
+  // タッチ判定に関わる状態が変わった(rootまで伝える)
+  bool input_changed_ = true;
+  // TIPS:ポインタ経由で書き換えられる(Editor)と変更を検出できない
+  bool input_watched_ = false;
+
+  // 描画内容(色、描画用の値、表示・非表示)が変わった
+  bool draw_dirty_ = true;
+  // 子孫に描画内容が変わったWidgetがいる
+  bool subtree_draw_dirty_ = false;
+  // TIPS:ポインタ経由で書き換えられる(Tween、Editor)Widgetは毎フレーム記録し直す
+  bool draw_watched_ = false;
+  bool subtree_draw_watched_ = false;
+
+  // 部分木の中でタッチ可能なWidgetの数(自分も含む)
+  //   TIPS:非表示の子供の部分木は数えない
+  u_int touchable_num_ = 0;
+
+
   bool active_      = true;       // 有効・無効
   bool display_     = true;       // 表示・非表示
   bool touch_event_ = false;      // タッチイベント有効・無効
+  bool clip_children_ = false;    // 子供を自分の領域で切り抜く
+  bool cache_as_layer_ = false;   // 部分木をテクスチャに描いて使い回す
 
   // TIPS:振る舞いの違いを継承を使わないで実現する作戦
-  std::map<std::string, boost::any> params_;
+  PropertyBlock properties_;
 
-  std::vector<WidgetPtr> childs_;
+  // TIPS:子供の所有はUI::WidgetArenaが行う
+  std::vector<Widget*> childs_;
   // クエリ用
   WidgetQueryPtr widgets_;
 
+  // UI::WidgetArena上のハンドル
+  WidgetHandle handle_;
+
+  // 値をTweenで書き換えているタイムライン
+  //   TIPS:タイムラインは値へのポインタを持ち続けるので、破棄する時にTweenを取り除く
+  std::vector<std::weak_ptr<ci::Timeline>> tween_timelines_;
+
   // タッチイベントのコールバック
-  using EventType = boost::signals2::signal<void (Widget&, const TouchEvent, const Touch&)>;
+  using EventType = Delegate<void (Widget&, const TouchEvent, const Touch&)>;
   EventType events_;
 
   // タッチイベント発生中
@@ -86,6 +165,82 @@ private:
   DrawFunc drawer_;
 
 
+  // Paramの名前と値の場所
+  // TIPS:並びはParamと同じ
+  struct ParamEntry
+  {
+    const char* name;
+    bool layout;              // 位置・サイズに影響する
+    float* (*get)(Widget&);
+  };
+
+  static const ParamEntry* paramTable() noexcept
+  {
+    static const ParamEntry table[] = {
+      { "rect_x1", true, [](Widget& w) { return &w.rect_.x1; } },
+      { "rect_x2", true, [](Widget& w) { return &w.rect_.x2; } },
+      { "rect_y1", true, [](Widget& w) { return &w.rect_.y1; } },
+      { "rect_y2", true, [](Widget& w) { return &w.rect_.y2; } },
+
+      { "pivot_x", true, [](Widget& w) { return &w.pivot_.x; } },
+      { "pivot_y", true, [](Widget& w) { return &w.pivot_.y; } },
+
+      { "anchor_min_x", true, [](Widget& w) { return &w.anchor_min_.x; } },
+      { "anchor_min_y", true, [](Widget& w) { return &w.anchor_min_.y; } },
+      { "anchor_max_x", true, [](Widget& w) { return &w.anchor_max_.x; } },
+      { "anchor_max_y", true, [](Widget& w) { return &w.anchor_max_.y; } },
+
+      { "scale_x", true, [](Widget& w) { return &w.scale_.x; } },
+      { "scale_y", true, [](Widget& w) { return &w.scale_.y; } },
+
+      { "color_r", false, [](Widget& w) { return &w.color_.r; } },
+      { "color_g", false, [](Widget& w) { return &w.color_.g; } },
+      { "color_b", false, [](Widget& w) { return &w.color_.b; } },
+      { "color_a", false, [](Widget& w) { return &w.color_.a; } },
+    };
+    static_assert((sizeof(table) / sizeof(table[0])) == PARAM_NUM, "ParamEntry mismatch");
+
+    return table;
+  }
+
+
+  void registerQuery() noexcept
+  {
+    if (!widgets_->insert(identifier_, this))
+    {
+      DOUT << "Duplicate identifier: " << identifier_ << std::endl;
+    }
+  }
+
+  // TIPS:同じ識別子で別のWidgetが登録されている事もある
+  void unregisterQuery() noexcept
+  {
+    widgets_->erase(identifier_, this);
+  }
+
+  // 自分か自分の子孫か
+  bool isSubtreeOf(const Widget* widget) const noexcept
+  {
+    for (auto* w = this; w; w = w->parent_)
+    {
+      if (w == widget) return true;
+    }
+    return false;
+  }
+
+  // 部分木を辿って探す
+  Widget* searchSubtree(const Atom& identifier) noexcept
+  {
+    if (identifier_ == identifier) return this;
+
+    for (auto* child : childs_)
+    {
+      if (auto* widget = child->searchSubtree(identifier)) return widget;
+    }
+    return nullptr;
+  }
+
+
   // タッチイベントを発生するか判定
   bool execTouchEvent() noexcept
   {
@@ -94,171 +249,267 @@ private:
 
 
 public:
-  Widget(std::string identifier, const ci::Rectf& rect,
-         const WidgetQueryPtr& widgets, DrawFunc drawer) noexcept
-    : identifier_(std::move(identifier)),
+  Widget(const Atom& identifier, const ci::Rectf& rect,
+         const WidgetQueryPtr& widgets, const DrawFunc& drawer) noexcept
+    : identifier_(identifier),
       rect_(rect),
       widgets_(widgets),
       drawer_(drawer)
   {
     // クエリ用のコンテナに自分を登録
-    widgets_->insert({ identifier_, this });
+    registerQuery();
   }
 
-  ~Widget() = default;
+  ~Widget()
+  {
+    // 破棄した場所(と再利用したWidget)を書き換えないように
+    removeTweens();
+    // クエリ用のコンテナから自分を外す
+    unregisterQuery();
+  }
 
 
   // FIXME:上流でシングルタッチ判定を行う
-  // TODO:酷いコピペを減らす
-  void touchBegan(const Touch& touch, const ci::Rectf& parent_rect, const ci::vec2& parent_scale) noexcept
+  // TIPS:rectはUI::Layoutで計算済みのもの
+  //      子供へはUI::Canvasが順に送る
+  void touchBegan(const Touch& touch, const ci::Rectf& rect) noexcept
   {
-    // TIPS:子供も含めて判定しない
-    if (!display_) return;
-
-    ci::vec2 scale = parent_scale * scale_;
-    auto rect = calcRect(parent_rect, scale);
+    if (!execTouchEvent()) return;
 
-    if (execTouchEvent())
+    if (rect.contains(touch.getPos()))
     {
-      if (rect.contains(touch.getPos()))
-      {
-        // タッチイベント発生
-        touching_ = true;
-        events_(*this, TouchEvent::BEGAN, touch);
-      }
+      // タッチイベント発生
+      touching_ = true;
+      events_(*this, TouchEvent::BEGAN, touch);
     }
+  }
+
+  void touchMoved(const Touch& touch, const ci::Rectf& rect) noexcept
+  {
+    if (!execTouchEvent() || !touching_) return;
 
-    for (auto& widget : childs_)
+    bool prev_in = rect.contains(touch.getPrevPos());
+    bool cur_in  = rect.contains(touch.getPos());
+
+    TouchEvent event = TouchEvent::MOVED_IN;
+
+    if (!cur_in && prev_in)
     {
-      widget->touchBegan(touch, rect, scale);
+      // 移動しながら領域外へ
+      event = TouchEvent::MOVED_EDGE_OUT;
     }
+    else if (cur_in && !prev_in)
+    {
+      // 移動しながら領域内へ
+      event = TouchEvent::MOVED_EDGE_IN;
+    }
+    else if (!cur_in && !prev_in)
+    {
+      // 領域外で移動
+      event = TouchEvent::MOVED_OUT;
+    }
+
+    events_(*this, event, touch);
   }
 
-  void touchMoved(const Touch& touch, const ci::Rectf& parent_rect, const ci::vec2& parent_scale) noexcept
+  void touchEnded(const Touch& touch, const ci::Rectf& rect) noexcept
   {
-    // TIPS:子供も含めて判定しない
-    if (!display_) return;
+    if (!execTouchEvent() || !touching_) return;
 
-    ci::vec2 scale = parent_scale * scale_;
-    auto rect = calcRect(parent_rect, scale);
+    touching_ = false;
 
-    if (execTouchEvent() && touching_)
-    {
-      bool prev_in = rect.contains(touch.getPrevPos());
-      bool cur_in  = rect.contains(touch.getPos());
+    TouchEvent event = rect.contains(touch.getPos()) ? TouchEvent::ENDED_IN
+                                                     : TouchEvent::ENDED_OUT;
+    events_(*this, event, touch);
+  }
 
-      TouchEvent event = TouchEvent::MOVED_IN;
 
-      if (!cur_in && prev_in)
-      {
-        // 移動しながら領域外へ
-        event = TouchEvent::MOVED_EDGE_OUT;
-      }
-      else if (cur_in && !prev_in)
-      {
-        // 移動しながら領域内へ
-        event = TouchEvent::MOVED_EDGE_IN;
-      }
-      else if (!cur_in && !prev_in)
-      {
-        // 領域外で移動
-        event = TouchEvent::MOVED_OUT;
-      }
+  // タッチイベント発生中か
+  bool isTouching() const noexcept
+  {
+    return touching_;
+  }
+
+
+  // TIPS:描画内容はlistに記録される
+  void draw(RenderList& list, const ci::Rectf& rect, const ci::vec2& scale) noexcept
+  {
+    // DOUT << identifier_ << std::endl
+    //      << rect << std::endl
+    //      << scale << std::endl;
+    
+    drawer_(list, *this, rect, scale);
+  }
+
+  // 描画関数の種類
+  //   TIPS:同じ種類をまとめて描画する時に使う
+  u_int getDrawType() const noexcept
+  {
+    return drawer_.type;
+  }
 
-      events_(*this, event, touch);
-    }
 
-    for (auto& widget : childs_)
+  // Rectの再計算を予約
+  void markLayoutDirty() noexcept
+  {
+    layout_dirty_ = true;
+
+    // TIPS:既に印が付いている所から上は辿らなくてよい
+    for (auto* widget = parent_; widget && !widget->subtree_dirty_; widget = widget->parent_)
     {
-      widget->touchMoved(touch, rect, scale);
+      widget->subtree_dirty_ = true;
     }
   }
 
-  void touchEnded(const Touch& touch, const ci::Rectf& parent_rect, const ci::vec2& parent_scale) noexcept
+  // 以下、UI::Layoutから使う
+  bool isLayoutDirty() const noexcept
   {
-    // TIPS:子供も含めて判定しない
-    if (!display_) return;
+    return layout_dirty_;
+  }
 
-    ci::vec2 scale = parent_scale * scale_;
-    auto rect = calcRect(parent_rect, scale);
+  bool isLayoutWatched() const noexcept
+  {
+    return layout_watched_;
+  }
 
-    if (execTouchEvent() && touching_)
-    {
-      touching_ = false;
+  bool hasDirtyDescendant() const noexcept
+  {
+    return subtree_dirty_ || subtree_watched_;
+  }
 
-      TouchEvent event = rect.contains(touch.getPos()) ? TouchEvent::ENDED_IN
-                                                       : TouchEvent::ENDED_OUT;
-      events_(*this, event, touch);
-    }
+  void clearLayoutDirty() noexcept
+  {
+    layout_dirty_ = false;
+  }
 
-    for (auto& widget : childs_)
-    {
-      widget->touchEnded(touch, rect, scale);
-    }
+  void clearSubtreeDirty() noexcept
+  {
+    subtree_dirty_ = false;
   }
 
+  bool isTreeChanged() const noexcept
+  {
+    return tree_changed_;
+  }
 
-  void draw(const ci::Rectf& parent_rect, const ci::vec2& parent_scale) noexcept
+  void clearTreeChanged() noexcept
   {
-    // TIPS:子供も含めて非表示
-    if (!display_) return;
+    tree_changed_ = false;
+  }
 
-    ci::vec2 scale = parent_scale * scale_;
-    auto rect = calcRect(parent_rect, scale);
+  bool isInputChanged() const noexcept
+  {
+    return input_changed_;
+  }
 
-    // DOUT << identifier_ << std::endl
-    //      << rect << std::endl
-    //      << scale << std::endl;
-    
-    drawer_(*this, rect, scale);
+  bool isInputWatched() const noexcept
+  {
+    return input_watched_;
+  }
+
+  void clearInputChanged() noexcept
+  {
+    input_changed_ = false;
+  }
+
+  // 描画内容の変更を予約
+  void markDrawDirty() noexcept
+  {
+    draw_dirty_ = true;
 
-    for (const auto& widget : childs_)
+    for (auto* widget = parent_; widget && !widget->subtree_draw_dirty_; widget = widget->parent_)
     {
-      widget->draw(rect, scale);
+      widget->subtree_draw_dirty_ = true;
     }
   }
 
+  // 以下、UI::Canvasから使う
+  bool isDrawDirty() const noexcept
+  {
+    return draw_dirty_ || draw_watched_;
+  }
+
+  bool hasDrawDirtyDescendant() const noexcept
+  {
+    return subtree_draw_dirty_ || subtree_draw_watched_;
+  }
+
+  void clearDrawDirty() noexcept
+  {
+    draw_dirty_ = false;
+    subtree_draw_dirty_ = false;
+  }
+
+  u_int getLayoutIndex() const noexcept
+  {
+    return layout_index_;
+  }
+
+  void setLayoutIndex(const u_int index) noexcept
+  {
+    layout_index_ = index;
+  }
+
 
   // 識別子
-  const std::string& getIdentifier() const noexcept
+  const Atom& getIdentifier() const noexcept
   {
     return identifier_;
   }
-  
+
   // for Editor
-  std::string& getIdentifier() noexcept
+  //   クエリ用のコンテナも書き換える
+  void setIdentifier(const Atom& identifier) noexcept
   {
-    return identifier_;
+    unregisterQuery();
+    identifier_ = identifier;
+    registerQuery();
   }
 
-  const std::string& getType() const noexcept
+  const Atom& getType() const noexcept
   {
     return type_;
   }
 
-  std::string& getType() noexcept
+  void setType(const Atom& type_id) noexcept
   {
-    return type_;
+    type_ = type_id;
   }
 
-  void setType(std::string type_id) noexcept
+  const ci::Rectf& getRect() const noexcept
   {
-    type_ = std::move(type_id);
+    return rect_;
   }
 
+  // for Editor
+  // TIPS:参照を渡すと書き換えを検出できないので監視対象にする
   ci::Rectf& getRect() noexcept
   {
+    watchLayout();
     return rect_;
   }
+
+  void setRect(const ci::Rectf& rect) noexcept
+  {
+    rect_ = rect;
+    markLayoutDirty();
+  }
   
+  const ci::vec2& getPivot() const noexcept
+  {
+    return pivot_;
+  }
+
   void setPivot(const ci::vec2& pivot) noexcept
   {
     pivot_ = pivot;
+    markLayoutDirty();
   }
 
   // for Editor
   ci::vec2& getPivot() noexcept
   {
+    watchLayout();
     return pivot_;
   }
   
@@ -266,29 +517,49 @@ public:
   {
     anchor_min_ = anchor_min;
     anchor_max_ = anchor_max;
+    markLayoutDirty();
+  }
+
+  const ci::vec2& getAnchorMin() const noexcept
+  {
+    return anchor_min_;
+  }
+
+  const ci::vec2& getAnchorMax() const noexcept
+  {
+    return anchor_max_;
   }
 
   // for Editor
   ci::vec2& getAnchorMin() noexcept
   {
+    watchLayout();
     return anchor_min_;
   }
 
   // for Editor
   ci::vec2& getAnchorMax() noexcept
   {
-    return anchor_min_;
+    watchLayout();
+    return anchor_max_;
   }
   
 
   void setScale(const ci::vec2& scale) noexcept
   {
     scale_ = scale;
+    markLayoutDirty();
+  }
+
+  const ci::vec2& getScale() const noexcept
+  {
+    return scale_;
   }
 
   // for Editor
   ci::vec2& getScale() noexcept
   {
+    watchLayout();
     return scale_;
   }
   
@@ -296,7 +567,13 @@ public:
   // 有効・無効
   void enableActive(const bool enable) noexcept
   {
+    if (active_ == enable) return;
+
+    u_int prev_self    = selfTouchable();
+    u_int prev_contrib = touchableContribution();
     active_ = enable;
+    updateTouchable(prev_self, prev_contrib);
+    markInputChanged();
   }
 
   bool isActive() const noexcept
@@ -306,13 +583,21 @@ public:
 
   bool& getActive() noexcept
   {
+    watchInput();
     return active_;
   }
   
   // 表示・非表示
   void enableDisplay(const bool enable) noexcept
   {
+    if (display_ == enable) return;
+
+    u_int prev_self    = selfTouchable();
+    u_int prev_contrib = touchableContribution();
     display_ = enable;
+    updateTouchable(prev_self, prev_contrib);
+    markInputChanged();
+    markDrawDirty();
   }
 
   bool isDisplay() const noexcept
@@ -322,13 +607,21 @@ public:
 
   bool& getDisplay() noexcept
   {
+    watchInput();
+    watchDraw();
     return display_;
   }
 
   // タッチイベントの有効・無効
   void enableTouchEvent(const bool enable) noexcept
   {
+    if (touch_event_ == enable) return;
+
+    u_int prev_self    = selfTouchable();
+    u_int prev_contrib = touchableContribution();
     touch_event_ = enable;
+    updateTouchable(prev_self, prev_contrib);
+    markInputChanged();
   }
 
   bool isTouchEvent() const noexcept
@@ -338,12 +631,76 @@ public:
 
   bool& getTouchEvent() noexcept
   {
+    watchInput();
     return touch_event_;
   }
 
+  // 子供を自分の領域外では描画しない
+  void enableClipChildren(const bool enable) noexcept
+  {
+    clip_children_ = enable;
+    markDrawDirty();
+  }
+
+  bool isClipChildren() const noexcept
+  {
+    return clip_children_;
+  }
+
+  bool& getClipChildren() noexcept
+  {
+    watchDraw();
+    return clip_children_;
+  }
+
+  // 部分木を一度テクスチャに描いて、変化があるまでそれを使う
+  //   TIPS:中身の多い、あまり変わらないパネル向け
+  void enableCacheAsLayer(const bool enable) noexcept
+  {
+    cache_as_layer_ = enable;
+    markDrawDirty();
+  }
+
+  bool isCacheAsLayer() const noexcept
+  {
+    return cache_as_layer_;
+  }
+
+  bool& getCacheAsLayer() noexcept
+  {
+    watchDraw();
+    return cache_as_layer_;
+  }
+
+  // 部分木にタッチ可能なWidgetがいるか
+  //   TIPS:いなければ部分木ごとタッチ判定を省ける
+  bool hasTouchable() const noexcept
+  {
+    return touchable_num_ > 0;
+  }
+
+  u_int getTouchableNum() const noexcept
+  {
+    return touchable_num_;
+  }
+
+  // 部分木を全部数え直す
+  //   ポインタ経由で書き換えられた時用
+  void recountTouchable() noexcept
+  {
+    touchable_num_ = selfTouchable();
+    for (const auto& child : childs_)
+    {
+      child->recountTouchable();
+      touchable_num_ += child->touchableContribution();
+    }
+  }
+
   // 基本色
+  // for Editor
   ci::ColorA& getColor() noexcept
   {
+    watchDraw();
     return color_;
   }
 
@@ -355,107 +712,336 @@ public:
   void setColor(const ci::ColorA& color) noexcept
   {
     color_ = color;
+    markDrawDirty();
   }
 
 
-  void addChild(const WidgetPtr& widget) noexcept
+  void addChild(Widget* widget) noexcept
   {
     childs_.push_back(widget);
+
+    widget->parent_ = this;
+    widget->markLayoutDirty();
+    widget->markDrawDirty();
+    if (widget->layout_watched_ || widget->subtree_watched_)
+    {
+      propagateWatched();
+    }
+    if (widget->draw_watched_ || widget->subtree_draw_watched_)
+    {
+      propagateDrawWatched();
+    }
+    if (widget->input_watched_)
+    {
+      watchInput();
+    }
+    if (widget->input_changed_)
+    {
+      markInputChanged();
+    }
+    addTouchable(int(widget->touchableContribution()));
+    markTreeChanged();
+    widgets_->invalidate();
   }
 
-  const std::vector<WidgetPtr>& getChilds() const noexcept
+  // 子供を外す
+  //   TIPS:破棄はしない
+  void removeChild(Widget* widget) noexcept
+  {
+    auto it = std::find(std::begin(childs_), std::end(childs_), widget);
+    if (it == std::end(childs_)) return;
+
+    childs_.erase(it);
+    addTouchable(-int(widget->touchableContribution()));
+    widget->parent_ = nullptr;
+    markTreeChanged();
+    widgets_->invalidate();
+  }
+
+  const std::vector<Widget*>& getChilds() const noexcept
   {
     return childs_;
   }
+
+  Widget* getParent() const noexcept
+  {
+    return parent_;
+  }
+
+  const WidgetHandle& getHandle() const noexcept
+  {
+    return handle_;
+  }
+
+  void setHandle(const WidgetHandle& handle) noexcept
+  {
+    handle_ = handle;
+  }
   
-  Widget* find(const std::string& identifier) noexcept
+  const WidgetQueryPtr& getQuery() const noexcept
+  {
+    return widgets_;
+  }
+
+  // 識別子から探す
+  //   見つからなければnullptr
+  Widget* find(const Atom& identifier) noexcept
   {
-    return widgets_->at(identifier);
+    return widgets_->find(identifier);
+  }
+
+  // 自分の部分木の中から探す
+  Widget* findInSubtree(const Atom& identifier) noexcept
+  {
+    auto* widget = widgets_->find(identifier);
+    if (widget && widget->isSubtreeOf(this)) return widget;
+
+    // TIPS:識別子が重複していると表は先に登録したものを返すので辿って探す
+    if (!widgets_->getDuplicateNum()) return nullptr;
+    return searchSubtree(identifier);
+  }
+
+  // 子供から探す
+  Widget* findChild(const Atom& identifier) noexcept
+  {
+    auto it = std::find_if(std::begin(childs_), std::end(childs_),
+                           [&identifier](const Widget* widget) { return widget->identifier_ == identifier; });
+    return (it != std::end(childs_)) ? *it : nullptr;
+  }
+
+  // "root/panel/button1"のような経路で探す
+  //   先頭は部分木の中から、それ以降は直接の子供から探す
+  //   TIPS:登録されていない名前はどのWidgetの識別子でもないので、その場で見つからない扱い
+  Widget* findPath(const std::string& path) noexcept
+  {
+    Widget* widget = nullptr;
+    size_t begin = 0;
+    while (true)
+    {
+      size_t end = std::min(path.find('/', begin), path.size());
+      Atom name;
+      if (!Atom::find(path.data() + begin, end - begin, name)) return nullptr;
+
+      widget = widget ? widget->findChild(name) : findInSubtree(name);
+      if (!widget || (end == path.size())) return widget;
+
+      begin = end + 1;
+    }
+  }
+
+  // 名前からParamを引く
+  //   見つからなければ-1
+  static int findParam(const Atom& name) noexcept
+  {
+    static const std::unordered_map<Atom, int> names = [] {
+      std::unordered_map<Atom, int> names;
+      for (int i = 0; i < PARAM_NUM; ++i)
+      {
+        names.insert({ Atom(paramTable()[i].name), i });
+      }
+      return names;
+    }();
+
+    auto it = names.find(name);
+    if (it == std::end(names)) return -1;
+
+    return it->second;
+  }
+
+  // Paramの示す値を返す
+  float* getParam(const Param param) noexcept
+  {
+    const auto& entry = paramTable()[param];
+    // TIPS:Tweenで書き換えられるので監視対象にする
+    if (entry.layout)
+    {
+      watchLayout();
+    }
+    else
+    {
+      watchDraw();
+    }
+    return entry.get(*this);
   }
 
   // 文字列の示す値を返す
-  float* getParam(const std::string& target) noexcept
-  {
-    std::map<std::string, std::function<float*()>> table = {
-      { "rect_x1", [this]() { return &rect_.x1; } },
-      { "rect_x2", [this]() { return &rect_.x2; } },
-      { "rect_y1", [this]() { return &rect_.y1; } },
-      { "rect_y2", [this]() { return &rect_.y2; } },
-      
-      { "pivot_x", [this]() { return &pivot_.x; } },
-      { "pivot_y", [this]() { return &pivot_.y; } },
-
-      { "anchor_min_x", [this]() { return &anchor_min_.x; } },
-      { "anchor_min_y", [this]() { return &anchor_min_.y; } },
-      { "anchor_max_x", [this]() { return &anchor_max_.x; } },
-      { "anchor_max_y", [this]() { return &anchor_max_.y; } },
-      
-      { "scale_x", [this]() { return &scale_.x; } },
-      { "scale_y", [this]() { return &scale_.y; } },
-
-      { "color_r", [this]() { return &color_.r; } },
-      { "color_g", [this]() { return &color_.g; } },
-      { "color_b", [this]() { return &color_.b; } },
-      { "color_a", [this]() { return &color_.a; } },
-    };
+  float* getParam(const Atom& target) noexcept
+  {
+    int param = findParam(target);
+    assert(param >= 0);
+    return getParam(Param(param));
+  }
 
-    float* param = table.at(target)();
-    return param;
+  // 値をTweenで書き換えるタイムラインを覚えておく
+  void addTweenTimeline(const ci::TimelineRef& timeline) noexcept
+  {
+    // TIPS:破棄されたタイムラインはついでに外す
+    tween_timelines_.erase(std::remove_if(std::begin(tween_timelines_), std::end(tween_timelines_),
+                                          [](const std::weak_ptr<ci::Timeline>& t) { return t.expired(); }),
+                           std::end(tween_timelines_));
+
+    auto it = std::find_if(std::begin(tween_timelines_), std::end(tween_timelines_),
+                           [&timeline](const std::weak_ptr<ci::Timeline>& t) { return t.lock() == timeline; });
+    if (it == std::end(tween_timelines_)) tween_timelines_.push_back(timeline);
+  }
+
+  // 自分の値を書き換えるTweenを全部取り除く
+  void removeTweens() noexcept
+  {
+    for (const auto& t : tween_timelines_)
+    {
+      auto timeline = t.lock();
+      if (!timeline) continue;
+
+      for (int i = 0; i < PARAM_NUM; ++i)
+      {
+        timeline->removeTarget(paramTable()[i].get(*this));
+      }
+    }
+    tween_timelines_.clear();
   }
   
 
   // パラメーターの読み書きを簡易に書くためのラッパー
-  const boost::any& operator[](const std::string& key) const noexcept
+  template<typename T>
+  void setProperty(const Atom& key, T value) noexcept
   {
-    return params_.at(key);
+    properties_.set(key, std::move(value));
+    markDrawDirty();
   }
 
-  boost::any& operator[](const std::string& key) noexcept
+  bool hasProperty(const Atom& key) const noexcept
   {
-    return params_[key];
+    return properties_.has(key);
   }
 
   template<typename T>
-  const T& at(const std::string& key) const noexcept
+  const T& at(const Atom& key) const noexcept
   {
-    return boost::any_cast<const T&>(params_.at(key));
+    return properties_.get<T>(key);
   }
 
+  // for Editor
   template<typename T>
-  T& at(const std::string& key) noexcept
+  T& at(const Atom& key) noexcept
   {
-    return boost::any_cast<T&>(params_.at(key));
+    watchDraw();
+    return properties_.get<T>(key);
   }
 
+  // 描画用
+  //   slot: UI::Drawerが指定した並びの番号
+  template<typename T>
+  const T& property(const u_int slot) const noexcept
+  {
+    return properties_.at<T>(slot);
+  }
+
+  // TIPS:生成時に使う
+  PropertyBlock& getProperties() noexcept
+  {
+    markDrawDirty();
+    return properties_;
+  }
 
+
+  // タッチイベントの通知先を登録
+  //   callback: void (const DelegateConnection&, Widget&, const TouchEvent, const Touch&)
   template<typename F>
-  Connection connect(F callback) noexcept
+  DelegateConnection connect(F callback) noexcept
   {
-    return events_.connect_extended(callback);
+    return events_.connect(callback);
   }
 
 
 private:
-  // 親の情報から自分の位置、サイズを計算
-  ci::Rectf calcRect(const ci::Rectf& parent_rect, const ci::vec2& scale) const noexcept
+  // ポインタ経由の書き換えを監視する
+  void watchLayout() noexcept
   {
-    ci::vec2 parent_size = parent_rect.getSize();
+    if (layout_watched_) return;
 
-    // 親のサイズとアンカーから左下・右上の座標を計算
-    ci::vec2 anchor_min = parent_size * anchor_min_;
-    ci::vec2 anchor_max = parent_size * anchor_max_;
+    layout_watched_ = true;
+    markLayoutDirty();
+    propagateWatched();
+  }
 
-    // 相対座標(スケーリング抜き)
-    ci::vec2 pos  = rect_.getUpperLeft() + anchor_min;
-    ci::vec2 size = rect_.getLowerRight() + anchor_max - pos;
+  void propagateWatched() noexcept
+  {
+    for (auto* widget = parent_; widget && !widget->subtree_watched_; widget = widget->parent_)
+    {
+      widget->subtree_watched_ = true;
+    }
+  }
+
+  void watchDraw() noexcept
+  {
+    if (draw_watched_) return;
+
+    draw_watched_ = true;
+    markDrawDirty();
+    propagateDrawWatched();
+  }
+
+  void propagateDrawWatched() noexcept
+  {
+    for (auto* widget = parent_; widget && !widget->subtree_draw_watched_; widget = widget->parent_)
+    {
+      widget->subtree_draw_watched_ = true;
+    }
+  }
+
+  void markTreeChanged() noexcept
+  {
+    for (auto* widget = this; widget && !widget->tree_changed_; widget = widget->parent_)
+    {
+      widget->tree_changed_ = true;
+    }
+  }
+
+  void markInputChanged() noexcept
+  {
+    for (auto* widget = this; widget && !widget->input_changed_; widget = widget->parent_)
+    {
+      widget->input_changed_ = true;
+    }
+  }
+
+  u_int selfTouchable() const noexcept
+  {
+    return (display_ && active_ && touch_event_) ? 1 : 0;
+  }
 
-    // pivotを考慮したスケーリング
-    ci::vec2 d = size * pivot_;
-    pos -= d * scale - d;
-    size *= scale;
+  // 親に数えられる分
+  u_int touchableContribution() const noexcept
+  {
+    return display_ ? touchable_num_ : 0;
+  }
 
-    ci::vec2 parent_pos = parent_rect.getUpperLeft();
-    return ci::Rectf(pos + parent_pos, pos + size + parent_pos);
+  // 自分と先祖の数を増減
+  //   TIPS:非表示のWidgetより上には影響しない
+  void addTouchable(const int delta) noexcept
+  {
+    for (auto* widget = this; widget && delta; widget = widget->parent_)
+    {
+      widget->touchable_num_ += delta;
+      if (!widget->display_) break;
+    }
+  }
+
+  void updateTouchable(const u_int prev_self, const u_int prev_contrib) noexcept
+  {
+    touchable_num_ = touchable_num_ - prev_self + selfTouchable();
+
+    int delta = int(touchableContribution()) - int(prev_contrib);
+    if (parent_) parent_->addTouchable(delta);
+  }
+
+  void watchInput() noexcept
+  {
+    for (auto* widget = this; widget && !widget->input_watched_; widget = widget->parent_)
+    {
+      widget->input_watched_ = true;
+    }
   }
 };
 
@@ -0,0 +1,138 @@
+﻿#pragma once
+
+//
+// UI::Widgetの置き場所
+//   まとまった領域を確保しておいて、そこにWidgetを作る
+//   破棄した場所は再利用する
+//   TIPS:領域は追加するだけなのでWidgetのアドレスは変わらない
+//
+
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <boost/noncopyable.hpp>
+#include "UIWidget.hpp"
+
+
+namespace ngs { namespace UI {
+
+class WidgetArena
+  : private boost::noncopyable
+{
+  // 一度に確保する数
+  static constexpr u_int chunk_size = 256;
+
+  using Storage = typename std::aligned_storage<sizeof(Widget), alignof(Widget)>::type;
+  std::vector<std::unique_ptr<Storage[]>> chunks_;
+
+  // 場所ごとの世代と使用中かどうか
+  std::vector<u_int> generation_;
+  std::vector<bool> alive_;
+
+  // 空いている場所
+  std::vector<u_int> free_;
+
+  u_int alive_num_ = 0;
+
+
+  Widget* at(const u_int index) const noexcept
+  {
+    return reinterpret_cast<Widget*>(&chunks_[index / chunk_size][index % chunk_size]);
+  }
+
+  u_int allocate() noexcept
+  {
+    if (!free_.empty())
+    {
+      u_int index = free_.back();
+      free_.pop_back();
+      return index;
+    }
+
+    u_int index = u_int(generation_.size());
+    if ((index % chunk_size) == 0)
+    {
+      chunks_.push_back(std::unique_ptr<Storage[]>(new Storage[chunk_size]));
+    }
+    generation_.push_back(0);
+    alive_.push_back(false);
+    return index;
+  }
+
+  // TIPS:子供から順に破棄する
+  void release(Widget* widget) noexcept
+  {
+    for (auto* child : widget->getChilds())
+    {
+      release(child);
+    }
+
+    u_int index = widget->getHandle().index;
+    widget->~Widget();
+
+    alive_[index] = false;
+    free_.push_back(index);
+    alive_num_ -= 1;
+  }
+
+
+public:
+  WidgetArena() = default;
+
+  ~WidgetArena()
+  {
+    for (u_int i = 0; i < u_int(alive_.size()); ++i)
+    {
+      if (alive_[i]) at(i)->~Widget();
+    }
+  }
+
+
+  // Widgetを作る
+  //   引数はWidgetのコンストラクタへ
+  template<typename... Args>
+  Widget* create(Args&&... args) noexcept
+  {
+    u_int index = allocate();
+    auto* widget = new (at(index)) Widget(std::forward<Args>(args)...);
+
+    // TIPS:世代は1から(0は無効)
+    generation_[index] += 1;
+    alive_[index] = true;
+    alive_num_ += 1;
+
+    widget->setHandle({ index, generation_[index] });
+    return widget;
+  }
+
+  // 部分木ごと破棄
+  //   親からは外される
+  void destroy(Widget* widget) noexcept
+  {
+    if (auto* parent = widget->getParent())
+    {
+      parent->removeChild(widget);
+    }
+    release(widget);
+  }
+
+  // ハンドルからWidgetを引く
+  //   破棄されていたらnullptr
+  Widget* get(const WidgetHandle& handle) const noexcept
+  {
+    if ((handle.index >= generation_.size())
+        || !alive_[handle.index]
+        || (generation_[handle.index] != handle.generation)) return nullptr;
+
+    return at(handle.index);
+  }
+
+  // 使用中の数
+  u_int size() const noexcept
+  {
+    return alive_num_;
+  }
+
+};
+
+} }
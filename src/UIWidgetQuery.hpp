@@ -0,0 +1,207 @@
+﻿#pragma once
+
+//
+// 識別子からUI::Widgetを引くための表
+//   オープンアドレス法(線形探査)のハッシュ表
+//   キーはAtomの番号なので文字列の比較もメモリ確保も無い
+//   TIPS:同じ識別子は最初に登録したものが有効
+//        後から登録したものも探査列の後ろに並べておき、解除されると次が有効になる
+//        登録・解除や親子関係が変わると世代が進む(UI::WidgetRef用)
+//
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "Atom.hpp"
+
+
+namespace ngs { namespace UI {
+
+class Widget;
+
+class WidgetQuery
+  : private boost::noncopyable
+{
+  // 一度も使っていない場所
+  static constexpr u_int empty_key = ~0u;
+
+  // TIPS:widgetがnullptrでkeyがempty_keyでなければ削除済み
+  struct Slot
+  {
+    u_int key = empty_key;
+    Widget* widget = nullptr;
+  };
+
+  std::vector<Slot> slots_;
+  u_int mask_ = 0;
+
+  u_int size_ = 0;
+  // 削除済みも含めた数
+  u_int used_ = 0;
+
+  // 隠れている(同じ識別子が先に登録されている)数
+  u_int duplicate_num_ = 0;
+
+  u_int generation_ = 0;
+
+
+  // TIPS:Atomの番号は連番なので掛け算で散らす
+  u_int home(const u_int key) const noexcept
+  {
+    return (key * 2654435769u) & mask_;
+  }
+
+  void rehash(const u_int capacity) noexcept
+  {
+    std::vector<Slot> slots(capacity);
+    std::swap(slots_, slots);
+    mask_ = capacity - 1;
+    used_ = size_;
+
+    // TIPS:同じ識別子の登録順を保つため、空き場所の次から探査列の順に入れ直す
+    u_int num = u_int(slots.size());
+    u_int start = 0;
+    while ((start < num) && (slots[start].key != empty_key)) start += 1;
+
+    for (u_int n = 0; n < num; ++n)
+    {
+      const auto& slot = slots[(start + n) % num];
+      if (!slot.widget) continue;
+
+      u_int i = home(slot.key);
+      while (slots_[i].key != empty_key)
+      {
+        i = (i + 1) & mask_;
+      }
+      slots_[i] = slot;
+    }
+  }
+
+
+public:
+  WidgetQuery() noexcept
+  {
+    rehash(16);
+  }
+
+
+  // 登録
+  //   既に同じ識別子があればfalse(その後ろに並べる)
+  bool insert(const Atom& identifier, Widget* widget) noexcept
+  {
+    // TIPS:使用率が3/4を超えたら広げる
+    if ((used_ + 1) * 4 > u_int(slots_.size()) * 3)
+    {
+      u_int capacity = u_int(slots_.size());
+      while ((size_ + 1) * 2 > capacity) capacity *= 2;
+      rehash(capacity);
+    }
+
+    u_int key = identifier.id();
+    Slot* vacant = nullptr;
+    bool duplicate = false;
+    for (u_int i = home(key); ; i = (i + 1) & mask_)
+    {
+      auto& slot = slots_[i];
+      if (slot.key == empty_key)
+      {
+        if (!vacant)
+        {
+          vacant = &slot;
+          used_ += 1;
+        }
+        break;
+      }
+
+      if (!slot.widget)
+      {
+        // 削除済みの場所は再利用する
+        if (!vacant) vacant = &slot;
+        continue;
+      }
+
+      if (slot.key == key)
+      {
+        // TIPS:先に登録したものより前には置かない
+        duplicate = true;
+        vacant = nullptr;
+      }
+    }
+
+    vacant->key    = key;
+    vacant->widget = widget;
+    size_ += 1;
+    if (duplicate) duplicate_num_ += 1;
+    invalidate();
+    return !duplicate;
+  }
+
+  // 登録解除
+  //   widgetが登録されている場合だけ
+  void erase(const Atom& identifier, const Widget* widget) noexcept
+  {
+    // TIPS:登録されていなくても経路での検索結果は変わりうる
+    invalidate();
+
+    u_int key = identifier.id();
+    u_int num = 0;
+    bool erased = false;
+    for (u_int i = home(key); slots_[i].key != empty_key; i = (i + 1) & mask_)
+    {
+      auto& slot = slots_[i];
+      if (!slot.widget || (slot.key != key)) continue;
+
+      if (!erased && (slot.widget == widget))
+      {
+        slot.widget = nullptr;
+        size_ -= 1;
+        erased = true;
+      }
+      else
+      {
+        num += 1;
+      }
+    }
+
+    // 残っているものがあれば、隠れていたものが一つ減る
+    if (erased && num) duplicate_num_ -= 1;
+  }
+
+  // 見つからなければnullptr
+  Widget* find(const Atom& identifier) const noexcept
+  {
+    u_int key = identifier.id();
+    for (u_int i = home(key); slots_[i].key != empty_key; i = (i + 1) & mask_)
+    {
+      const auto& slot = slots_[i];
+      if (slot.widget && (slot.key == key)) return slot.widget;
+    }
+    return nullptr;
+  }
+
+
+  // 検索結果が変わったかもしれない
+  void invalidate() noexcept
+  {
+    generation_ += 1;
+  }
+
+  u_int getGeneration() const noexcept
+  {
+    return generation_;
+  }
+
+
+  u_int size() const noexcept
+  {
+    return size_;
+  }
+
+  // 同じ識別子が先に登録されていて隠れている数
+  u_int getDuplicateNum() const noexcept
+  {
+    return duplicate_num_;
+  }
+
+};
+
+} }
@@ -0,0 +1,92 @@
+﻿#pragma once
+
+//
+// UI::Widgetの検索結果を覚えておく
+//   一度探したWidgetを保持して、木構造が変わった時だけ探し直す
+//   TIPS:破棄されたWidgetを指し続ける事はない
+//
+
+#include <string>
+#include "UICanvas.hpp"
+
+
+namespace ngs { namespace UI {
+
+class WidgetRef
+{
+  Canvas* canvas_ = nullptr;
+
+  // 識別子か"root/panel/button1"のような経路
+  std::string path_;
+  Atom identifier_;
+  bool is_path_ = false;
+
+  Widget* widget_ = nullptr;
+  // TIPS:表を保持しておくことで、作り直された表と取り違えない
+  WidgetQueryPtr query_;
+  u_int generation_ = 0;
+
+
+  void resolve() noexcept
+  {
+    auto* root = canvas_->rootWidget();
+    if (!root)
+    {
+      widget_ = nullptr;
+      query_.reset();
+      return;
+    }
+
+    widget_     = is_path_ ? canvas_->findWidgetPath(path_) : canvas_->findWidget(identifier_);
+    query_      = root->getQuery();
+    generation_ = query_->getGeneration();
+  }
+
+  bool isValid() const noexcept
+  {
+    auto* root = canvas_->rootWidget();
+    return root
+           && (root->getQuery() == query_)
+           && (query_->getGeneration() == generation_);
+  }
+
+
+public:
+  WidgetRef() = default;
+
+  WidgetRef(Canvas& canvas, std::string path) noexcept
+    : canvas_(&canvas),
+      path_(std::move(path)),
+      is_path_(path_.find('/') != std::string::npos)
+  {
+    if (!is_path_) identifier_ = Atom(path_);
+  }
+
+
+  // 見つからなければnullptr
+  Widget* get() noexcept
+  {
+    if (!canvas_) return nullptr;
+    if (!isValid()) resolve();
+
+    return widget_;
+  }
+
+  Widget* operator->() noexcept
+  {
+    return get();
+  }
+
+  explicit operator bool() noexcept
+  {
+    return get() != nullptr;
+  }
+
+  const std::string& getPath() const noexcept
+  {
+    return path_;
+  }
+
+};
+
+} }
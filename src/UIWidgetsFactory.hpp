@@ -2,25 +2,26 @@
 
 //
 // UI::WidgetsをJSONから生成
+//   DrawerType: 描画関数や画像、フォントを用意する
+//               UI::Drawer(OpenGL)かUI::NullDrawer(描画しない)
 //
 
-#include <cinder/ImageIo.h>
-#include "Font.hpp"
+#include "JsonUtil.hpp"
 #include "UIWidget.hpp"
-#include "UIDrawer.hpp"
-#include "Misc.hpp"
+#include "UIWidgetArena.hpp"
 
 
 namespace ngs { namespace UI {
 
+template<typename DrawerType>
 class WidgetsFactory
   : private boost::noncopyable
 {
-  Drawer& drwer_;
+  DrawerType& drwer_;
   
   
   // 各種値をJsonから読み取る
-  void loadParams(const WidgetPtr& widget, const ci::JsonTree& params) noexcept
+  void loadParams(Widget* widget, const ci::JsonTree& params) noexcept
   {
     for (const auto& p : params["params"])
     {
@@ -33,35 +34,35 @@ class WidgetsFactory
             ci::Color color(params.getValueAtIndex<float>(1),
                             params.getValueAtIndex<float>(2),
                             params.getValueAtIndex<float>(3));
-            widget[params.getKey()] = color;
+            widget.setProperty(params.getKey(), color);
           }
         },
         {
           "string",
           [](Widget& widget, const ci::JsonTree& params)
           {
-            widget[params.getKey()] = params.getValueAtIndex<std::string>(1);
+            widget.setProperty(params.getKey(), params.getValueAtIndex<std::string>(1));
           }
         },
         {
           "int",
           [](Widget& widget, const ci::JsonTree& params)
           {
-            widget[params.getKey()] = params.getValueAtIndex<int>(1);
+            widget.setProperty(params.getKey(), params.getValueAtIndex<int>(1));
           }
         },
         {
           "float",
           [](Widget& widget, const ci::JsonTree& params)
           {
-            widget[params.getKey()] = params.getValueAtIndex<float>(1);
+            widget.setProperty(params.getKey(), params.getValueAtIndex<float>(1));
           }
         },
         {
           "double",
           [](Widget& widget, const ci::JsonTree& params)
           {
-            widget[params.getKey()] = params.getValueAtIndex<double>(1);
+            widget.setProperty(params.getKey(), params.getValueAtIndex<double>(1));
           }
         },
         {
@@ -71,7 +72,7 @@ class WidgetsFactory
             ci::vec2 vec(params.getValueAtIndex<float>(1),
                          params.getValueAtIndex<float>(2));
             
-            widget[params.getKey()] = vec;
+            widget.setProperty(params.getKey(), vec);
           }
         },
         {
@@ -82,17 +83,18 @@ class WidgetsFactory
                          params.getValueAtIndex<float>(2),
                          params.getValueAtIndex<float>(3));
             
-            widget[params.getKey()] = vec;
+            widget.setProperty(params.getKey(), vec);
           }
         },
         {
           "image",
-          [](Widget& widget, const ci::JsonTree& params)
+          [this](Widget& widget, const ci::JsonTree& params)
           {
             const auto& path = params.getValueAtIndex<std::string>(1);
-            auto image = ci::gl::Texture2d::create(ci::loadImage(Asset::load(path)));
-            widget[params.getKey()] = image;
-            widget["path"] = path;
+            auto image = drwer_.loadImage(path);
+            widget.setProperty(params.getKey(), image.texture);
+            widget.setProperty("uv", image.uv);
+            widget.setProperty("path", path);
           }
         },
         {
@@ -101,28 +103,28 @@ class WidgetsFactory
           {
             const auto& path = params.getValueAtIndex<std::string>(1);
             drwer_.addFont(path);
-            widget[params.getKey()] = path;
+            widget.setProperty(params.getKey(), path);
           }
         }
       };
       
       // 配列の最初の値が型
       auto type = p.getValueAtIndex<std::string>(0);
-      functions.at(type)(*widget.get(), p);
+      functions.at(type)(*widget, p);
     }
   }
 
   // JSONから生成(階層構造も含む)
-  WidgetPtr create(const ci::JsonTree& params,
-                   const WidgetQueryPtr& widgets) noexcept
+  Widget* create(const ci::JsonTree& params,
+                 const WidgetQueryPtr& widgets, WidgetArena& arena) noexcept
   {
     // UI::Widgetを生成するのに必要な値
     auto identifier = params.getValueForKey<std::string>("identifier");
     auto rect = Json::getRect(params["rect"]);
-    const auto& type_id = params.getValueForKey<std::string>("type");
-    DrawFunc draw_func = drwer_.getFunc(type_id);
+    Atom type_id(params.getValueForKey<std::string>("type"));
+    const DrawFunc& draw_func = drwer_.getFunc(type_id);
 
-    auto widget = std::make_shared<UI::Widget>(identifier, rect, widgets, draw_func);
+    auto* widget = arena.create(identifier, rect, widgets, draw_func);
     widget->setType(type_id);
 
     // アンカー
@@ -152,9 +154,18 @@ class WidgetsFactory
     widget->enableActive(params.getValueForKey<bool>("active"));
     widget->enableDisplay(params.getValueForKey<bool>("display"));
     widget->enableTouchEvent(params.getValueForKey<bool>("touch_event"));
+    widget->enableClipChildren(Json::getValue(params, "clip_children", false));
+    widget->enableCacheAsLayer(Json::getValue(params, "cache_as_layer", false));
     
     // パラメーター読み込み
     loadParams(widget, params);
+    // TIPS:描画関数が読む順番に並べておく(型もここで確認)
+    bool arranged = widget->getProperties().arrange(drwer_.getSchema(type_id));
+    if (!arranged)
+    {
+      DOUT << "Invalid params: " << identifier << std::endl;
+      assert(arranged);
+    }
 
     // 子供を追加
     // TIPS:再帰で実装
@@ -162,7 +173,7 @@ class WidgetsFactory
     {
       for (const auto& child : params["childlen"])
       {
-        widget->addChild(create(child, widgets));
+        widget->addChild(create(child, widgets, arena));
       }
     }
     
@@ -171,7 +182,7 @@ class WidgetsFactory
 
   
 public:
-  WidgetsFactory(Drawer& drwer) noexcept
+  WidgetsFactory(DrawerType& drwer) noexcept
     : drwer_(drwer)
   {
   }
@@ -180,11 +191,12 @@ public:
 
 
   // JSONからWidgetを生成する
-  WidgetPtr construct(const ci::JsonTree& params) noexcept
+  //   arena: Widgetを作る場所
+  Widget* construct(const ci::JsonTree& params, WidgetArena& arena) noexcept
   {
     // クエリ用
     auto widgets = std::make_shared<WidgetQuery>();
-    return create(params, widgets);
+    return create(params, widgets, arena);
   }
   
 };
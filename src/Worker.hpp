@@ -35,13 +35,16 @@ class Worker
   UI::Drawer drawer_;
   
   // UI生成用
-  UI::WidgetsFactory widgets_factory_;
+  UI::WidgetsFactory<UI::Drawer> widgets_factory_;
   
   Scene scene_;
 
   bool touching_ = false;
   uint32_t touch_id_;
 
+  // 描画回数が変わった時だけ表示する
+  u_int batch_draw_num_ = 0;
+
   
   // UI編集
   UI::Editor editor_;
@@ -52,11 +55,15 @@ public:
   : params_(Params::load("params.json")),
     timeline_(ci::Timeline::create()),
     widgets_factory_(drawer_),
-    scene_(Params::load("scene_test.json"), widgets_factory_),
+    scene_(Params::load("scene_test.json"), widgets_factory_, ci::app::getWindowSize()),
     editor_(scene_.getCanvas(), drawer_)
   {
+    DOUT << "Atlas: " << drawer_.getAtlas().getPageNum() << " pages "
+         << drawer_.getAtlas().getFillRate() * 100.0f << "% filled, "
+         << drawer_.getAtlas().getStandaloneNum() << " standalone" << std::endl;
+
     // コールバック関数
-    auto callback = [this](Connection, UI::Widget& widget, const UI::Widget::TouchEvent touch_event, const Touch&)
+    auto callback = [this](const DelegateConnection&, UI::Widget& widget, const UI::Widget::TouchEvent touch_event, const Touch&)
       {
         DOUT << widget.getIdentifier() << ":";
 
@@ -196,7 +203,21 @@ public:
   void draw() noexcept
   {
     ci::gl::clear(ci::Color(0, 0, 0));
+
+    ci::gl::setMatrices(scene_.getCanvas().getCamera());
     scene_.getCanvas().draw();
+    drawer_.draw(scene_.getCanvas().getRenderList());
+
+    if (drawer_.getGlyphUploadNum())
+    {
+      DOUT << "Glyph: " << drawer_.getGlyphUploadBytes() << " bytes, "
+           << drawer_.getGlyphUploadNum() << " uploads" << std::endl;
+    }
+    if (drawer_.getBatchDrawNum() != batch_draw_num_)
+    {
+      batch_draw_num_ = drawer_.getBatchDrawNum();
+      DOUT << "Batch: " << batch_draw_num_ << " draws" << std::endl;
+    }
 
     editor_.draw();
   }
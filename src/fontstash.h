@@ -132,6 +132,13 @@ int fonsValidateTexture(FONScontext* s, int* dirty);
 // Draws the stash texture for debugging
 void fonsDrawDebug(FONScontext* s, float x, float y);
 
+// Skyline rectangle packer used by the glyph atlas, usable by other atlases
+typedef struct FONSatlas FONSatlas;
+FONSatlas* fonsCreateAtlas(int width, int height, int nnodes);
+void fonsDeleteAtlas(FONSatlas* atlas);
+// Returns 0 if the rectangle does not fit
+int fonsAtlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry);
+
 #endif // FONTSTASH_H
 
 
@@ -678,6 +685,21 @@ static int fons__atlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry
 	return 1;
 }
 
+FONSatlas* fonsCreateAtlas(int width, int height, int nnodes)
+{
+	return fons__allocAtlas(width, height, nnodes);
+}
+
+void fonsDeleteAtlas(FONSatlas* atlas)
+{
+	fons__deleteAtlas(atlas);
+}
+
+int fonsAtlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry)
+{
+	return fons__atlasAddRect(atlas, rw, rh, rx, ry);
+}
+
 static void fons__addWhiteRect(FONScontext* stash, int w, int h)
 {
 	int x, y, gx, gy;